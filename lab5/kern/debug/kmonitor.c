@@ -4,6 +4,18 @@
 #include <trap.h>
 #include <kmonitor.h>
 #include <kdebug.h>
+#include <proc.h>
+#include <vmm.h>
+#include <trace.h>
+#include <ksm.h>
+#include <pid.h>
+#include <kstack.h>
+#include <workqueue.h>
+#include <initrd.h>
+#include <template.h>
+#include <sched.h>
+#include <cfs_sched.h>
+#include <lockstat.h>
 
 /* *
  * Simple command-line kernel monitor useful for controlling the
@@ -22,6 +34,18 @@ static struct command commands[] = {
     {"help", "Display this list of commands.", mon_help},
     {"kerninfo", "Display information about the kernel.", mon_kerninfo},
     {"backtrace", "Print backtrace of stack frame.", mon_backtrace},
+    {"vma", "Display the vma layout of a process: vma [pid].", mon_vma},
+    {"trace", "Drain the trace buffer, or set the mask: trace [mask <hex>].", mon_trace},
+    {"faults", "Display page fault and fault-around statistics.", mon_faults},
+    {"ksm", "Display same-page merging statistics, or pause it: ksm [run 0|1].", mon_ksm},
+    {"pid", "Display pid allocation, or set the pid space: pid [max <n>].", mon_pid},
+    {"locks", "Display mutex and semaphore contention per lock class.", mon_locks},
+    {"kstack", "Display the kernel stack cache and its hit rate.", mon_kstack},
+    {"wq", "Display the depth and latency of every workqueue.", mon_wq},
+    {"reap", "Display address space reaping, or make it synchronous: reap [async 0|1].", mon_reap},
+    {"initrd", "List the programs in the initrd.", mon_initrd},
+    {"templates", "Display exec templates, or turn them off: templates [enable 0|1].", mon_templates},
+    {"sched", "Display the scheduler and its queues, or tune the fair one: sched [latency|granularity <ms>].", mon_sched},
 };
 
 /* return if kernel is panic, in kern/debug/panic.c */
@@ -145,3 +169,173 @@ int mon_backtrace(int argc, char **argv, struct trapframe *tf)
     print_stackframe();
     return 0;
 }
+
+/* *
+ * mon_vma - print the vmas of the process with the given pid, or of the
+ * current process if no pid is given.
+ * */
+int mon_vma(int argc, char **argv, struct trapframe *tf)
+{
+    struct proc_struct *proc = current;
+    if (argc > 1 && (proc = find_proc(strtol(argv[1], NULL, 10))) == NULL)
+    {
+        cprintf("vma: no process %s\n", argv[1]);
+        return 0;
+    }
+    if (proc == NULL || proc->mm == NULL)
+    {
+        cprintf("vma: process %d has no user memory\n", proc == NULL ? -1 : proc->pid);
+        return 0;
+    }
+    cprintf("process %d (%s):\n", proc->pid, proc->name);
+    print_mm(proc->mm);
+    return 0;
+}
+
+/* *
+ * mon_trace - print and consume the recorded trace events, or set the
+ * runtime subsystem mask with "trace mask <hex>".
+ * */
+int mon_trace(int argc, char **argv, struct trapframe *tf)
+{
+    if (argc > 2 && strcmp(argv[1], "mask") == 0)
+    {
+        trace_mask = strtol(argv[2], NULL, 16);
+    }
+    else
+    {
+        int n = trace_dump(TRACE_ALL);
+        cprintf("trace: %d events, level %d, mask 0x%x\n", n, TRACE_LEVEL, trace_mask);
+    }
+    return 0;
+}
+
+/* *
+ * mon_faults - print the page fault counters, see print_fault_stats in
+ * kern/mm/vmm.c
+ * */
+int mon_faults(int argc, char **argv, struct trapframe *tf)
+{
+    print_fault_stats();
+    return 0;
+}
+
+/* *
+ * mon_ksm - print the ksmd counters, see print_ksm_stats in kern/mm/ksm.c,
+ * or pause and resume scanning with "ksm run 0|1".
+ * */
+int mon_ksm(int argc, char **argv, struct trapframe *tf)
+{
+    if (argc > 2 && strcmp(argv[1], "run") == 0)
+    {
+        ksm_run = (strtol(argv[2], NULL, 10) != 0);
+    }
+    print_ksm_stats();
+    return 0;
+}
+
+/* *
+ * mon_pid - print the pid allocator state, or change pid_max with
+ * "pid max <n>", see kern/process/pid.c.
+ * */
+int mon_pid(int argc, char **argv, struct trapframe *tf)
+{
+    if (argc > 2 && strcmp(argv[1], "max") == 0 && set_pid_max(strtol(argv[2], NULL, 10)) != 0)
+    {
+        cprintf("pid max must be in [%d, %d].\n", 2 * PIDMAP_PIDS, PID_MAX_LIMIT);
+    }
+    print_pid_stats();
+    return 0;
+}
+
+/* *
+ * mon_locks - print the contention counters of every lock class, see
+ * kern/sync/lockstat.c
+ * */
+int mon_locks(int argc, char **argv, struct trapframe *tf)
+{
+    print_lock_stats();
+    return 0;
+}
+
+/* *
+ * mon_kstack - print the kernel stack cache counters, see
+ * kern/process/kstack.c
+ * */
+int mon_kstack(int argc, char **argv, struct trapframe *tf)
+{
+    print_kstack_stats();
+    return 0;
+}
+
+/* *
+ * mon_wq - print the queue depth and latency counters of every workqueue,
+ * see kern/process/workqueue.c
+ * */
+int mon_wq(int argc, char **argv, struct trapframe *tf)
+{
+    print_workqueue_stats();
+    return 0;
+}
+
+/* *
+ * mon_reap - print how exited address spaces are freed, or free them in
+ * exit_mm itself with "reap async 0", see exit_mm in kern/mm/vmm.c
+ * */
+int mon_reap(int argc, char **argv, struct trapframe *tf)
+{
+    if (argc > 2 && strcmp(argv[1], "async") == 0)
+    {
+        mm_reap_async = (strtol(argv[2], NULL, 10) != 0);
+    }
+    print_reap_stats();
+    return 0;
+}
+
+/* *
+ * mon_initrd - list the files of the initrd, see kern/fs/initrd.c
+ * */
+int mon_initrd(int argc, char **argv, struct trapframe *tf)
+{
+    print_initrd();
+    return 0;
+}
+
+/* *
+ * mon_templates - print the exec templates, or turn them off with
+ * "templates enable 0", which drops them too, see kern/process/template.c
+ * */
+int mon_templates(int argc, char **argv, struct trapframe *tf)
+{
+    if (argc > 2 && strcmp(argv[1], "enable") == 0)
+    {
+        if (!(template_enable = (strtol(argv[2], NULL, 10) != 0)))
+        {
+            template_flush();
+        }
+    }
+    print_template_stats();
+    return 0;
+}
+
+/* *
+ * mon_sched - print the scheduling class and its run queue, or set the target
+ * latency or the minimum granularity of the fair scheduler, see cfs_sched.c
+ * */
+int mon_sched(int argc, char **argv, struct trapframe *tf)
+{
+    if (argc > 2)
+    {
+        uint64_t ns = (uint64_t)strtol(argv[2], NULL, 10) * 1000000;
+        if (strcmp(argv[1], "latency") == 0 && ns != 0)
+        {
+            cfs_latency_ns = ns;
+        }
+        else if (strcmp(argv[1], "granularity") == 0 && ns != 0)
+        {
+            cfs_min_granularity_ns = ns;
+        }
+    }
+    print_sched();
+    return 0;
+}
@@ -8,6 +8,18 @@ void kmonitor(struct trapframe *tf);
 int mon_help(int argc, char **argv, struct trapframe *tf);
 int mon_kerninfo(int argc, char **argv, struct trapframe *tf);
 int mon_backtrace(int argc, char **argv, struct trapframe *tf);
+int mon_vma(int argc, char **argv, struct trapframe *tf);
+int mon_trace(int argc, char **argv, struct trapframe *tf);
+int mon_faults(int argc, char **argv, struct trapframe *tf);
+int mon_ksm(int argc, char **argv, struct trapframe *tf);
+int mon_pid(int argc, char **argv, struct trapframe *tf);
+int mon_locks(int argc, char **argv, struct trapframe *tf);
+int mon_kstack(int argc, char **argv, struct trapframe *tf);
+int mon_wq(int argc, char **argv, struct trapframe *tf);
+int mon_reap(int argc, char **argv, struct trapframe *tf);
+int mon_initrd(int argc, char **argv, struct trapframe *tf);
+int mon_templates(int argc, char **argv, struct trapframe *tf);
+int mon_sched(int argc, char **argv, struct trapframe *tf);
 int mon_continue(int argc, char **argv, struct trapframe *tf);
 int mon_step(int argc, char **argv, struct trapframe *tf);
 int mon_breakpoint(int argc, char **argv, struct trapframe *tf);
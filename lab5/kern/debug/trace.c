@@ -0,0 +1,139 @@
+#include <defs.h>
+#include <riscv.h>
+#include <stdio.h>
+#include <sync.h>
+#include <proc.h>
+#include <assert.h>
+#include <trace.h>
+
+/* *
+ * The events live in one ring buffer (the kernel runs on a single hart).
+ * trace_head is the total number of recorded events and trace_tail the number
+ * of drained ones; when the buffer is full the oldest event is overwritten and
+ * counted in trace_nlost. Recording only copies a few words with interrupts
+ * off, formatting is left to trace_dump.
+ * */
+
+volatile uint32_t trace_mask = 0;
+
+static struct trace_event trace_buf[TRACE_BUFSIZE];
+static size_t trace_head, trace_tail, trace_nlost;
+
+static const char *trace_subsys_name[] = {"mm", "fork", "exec", "proc"};
+static const char *trace_level_name[] = {"none", "error", "info", "debug"};
+
+static void check_trace(void);
+
+// __trace_record - append an event to the ring buffer, called by trace()
+void __trace_record(uint32_t level, uint32_t subsys, const char *fmt, const uint64_t *args)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (trace_head - trace_tail == TRACE_BUFSIZE)
+        {
+            trace_tail++, trace_nlost++;
+        }
+        struct trace_event *ev = &trace_buf[trace_head++ % TRACE_BUFSIZE];
+        ev->time = rdtime();
+        ev->fmt = fmt;
+        int i;
+        for (i = 0; i < TRACE_NARGS; i++)
+        {
+            ev->args[i] = args[i];
+        }
+        ev->subsys = subsys;
+        ev->pid = (current != NULL) ? current->pid : -1;
+        ev->level = level;
+    }
+    local_intr_restore(intr_flag);
+}
+
+static const char *
+trace_name(uint32_t subsys)
+{
+    int i;
+    for (i = 0; i < sizeof(trace_subsys_name) / sizeof(trace_subsys_name[0]); i++)
+    {
+        if (subsys & (1 << i))
+        {
+            return trace_subsys_name[i];
+        }
+    }
+    return "?";
+}
+
+// trace_dump - drain the ring buffer, printing the events of the subsystems in subsys_mask
+// return value: the number of events printed
+int trace_dump(uint32_t subsys_mask)
+{
+    int n = 0;
+    if (trace_nlost != 0)
+    {
+        cprintf("trace: %d events lost\n", (int)trace_nlost);
+        trace_nlost = 0;
+    }
+    while (trace_tail != trace_head)
+    {
+        struct trace_event ev;
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        {
+            ev = trace_buf[trace_tail++ % TRACE_BUFSIZE];
+        }
+        local_intr_restore(intr_flag);
+
+        if (!(ev.subsys & subsys_mask))
+        {
+            continue;
+        }
+        cprintf("[%016llx] %d %s/%s: ", ev.time, ev.pid, trace_name(ev.subsys),
+                (ev.level <= TRACE_DEBUG) ? trace_level_name[ev.level] : "?");
+        cprintf(ev.fmt, ev.args[0], ev.args[1], ev.args[2], ev.args[3]);
+        n++;
+    }
+    return n;
+}
+
+// trace_lost - the number of events overwritten before they were drained
+size_t trace_lost(void)
+{
+    return trace_nlost;
+}
+
+// trace_init - reset the ring buffer and check it
+void trace_init(void)
+{
+    static_assert((TRACE_BUFSIZE & (TRACE_BUFSIZE - 1)) == 0);
+    trace_head = trace_tail = trace_nlost = 0;
+    check_trace();
+}
+
+static void
+check_trace(void)
+{
+    uint32_t mask = trace_mask;
+    trace_mask = 0;
+
+    // masked off subsystems record nothing
+    trace(TRACE_ERROR, TRACE_MM, "check_trace: masked\n");
+    assert(trace_head == trace_tail);
+
+    // overflow keeps the newest TRACE_BUFSIZE events
+    trace_mask = TRACE_PROC;
+    int i;
+    for (i = 0; i < TRACE_BUFSIZE + 3; i++)
+    {
+        uint64_t args[TRACE_NARGS] = {i};
+        __trace_record(TRACE_ERROR, TRACE_PROC, "check_trace: %d\n", args);
+    }
+    assert(trace_head - trace_tail == TRACE_BUFSIZE && trace_lost() == 3);
+    assert(trace_buf[trace_tail % TRACE_BUFSIZE].args[0] == 3);
+
+    // draining with an empty mask consumes the events without printing them
+    assert(trace_dump(0) == 0);
+    assert(trace_head == trace_tail && trace_lost() == 0);
+
+    trace_mask = mask;
+    cprintf("check_trace() succeeded!\n");
+}
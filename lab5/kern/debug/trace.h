@@ -0,0 +1,64 @@
+#ifndef __KERN_DEBUG_TRACE_H__
+#define __KERN_DEBUG_TRACE_H__
+
+#include <defs.h>
+
+/* *
+ * Kernel event tracing.
+ *
+ * trace(level, subsys, fmt, ...) records an event into a ring buffer instead of
+ * printing it; the monitor command "trace" drains and formats the buffer.
+ *
+ * Events above TRACE_LEVEL are compiled out completely, so hot paths may trace
+ * at TRACE_DEBUG for free in a normal build (make TRACE_LEVEL=3 to keep them).
+ * Compiled-in events are recorded only if their subsystem is set in trace_mask,
+ * which costs a load and a branch when the subsystem is off.
+ *
+ * fmt must be a string literal (only the pointer is stored) and the arguments
+ * must be integers, at most TRACE_NARGS of them; cast pointers to uintptr_t.
+ * */
+
+#define TRACE_NONE          0
+#define TRACE_ERROR         1
+#define TRACE_INFO          2
+#define TRACE_DEBUG         3
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL         TRACE_INFO
+#endif
+
+/* subsystems, bits of trace_mask */
+#define TRACE_MM            0x00000001  // page faults
+#define TRACE_FORK          0x00000002  // address space duplication
+#define TRACE_EXEC          0x00000004  // program loading
+#define TRACE_PROC          0x00000008  // process life cycle
+#define TRACE_ALL           0xffffffff
+
+#define TRACE_NARGS         4
+#define TRACE_BUFSIZE       256         // # of events, must be a power of 2
+
+struct trace_event {
+    uint64_t time;                      // rdtime when the event was recorded
+    const char *fmt;                    // format string, a literal
+    uint64_t args[TRACE_NARGS];         // arguments for fmt
+    uint32_t subsys;                    // TRACE_MM, TRACE_FORK ...
+    int32_t pid;                        // pid of current, -1 if none
+    uint16_t level;
+};
+
+extern volatile uint32_t trace_mask;
+
+void trace_init(void);
+void __trace_record(uint32_t level, uint32_t subsys, const char *fmt, const uint64_t *args);
+int trace_dump(uint32_t subsys_mask);
+size_t trace_lost(void);
+
+#define trace(level, subsys, fmt, ...)                                          \
+    do {                                                                        \
+        if (TRACE_LEVEL >= (level) && (trace_mask & (subsys))) {                \
+            __trace_record((level), (subsys), (fmt),                            \
+                           (const uint64_t[TRACE_NARGS]){__VA_ARGS__});         \
+        }                                                                       \
+    } while (0)
+
+#endif /* !__KERN_DEBUG_TRACE_H__ */
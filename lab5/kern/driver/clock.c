@@ -44,3 +44,11 @@ void clock_init(void) {
 }
 
 void clock_set_next_event(void) { sbi_set_timer(get_cycles() + timebase); }
+
+// clock_gettime_msec - milliseconds since boot, read from the time csr
+// rather than counted in ticks, so it is finer than the 10ms timer period
+uint64_t clock_gettime_msec(void) { return get_cycles() / (timebase / 10); }
+
+// clock_gettime_nsec - nanoseconds since boot, in steps of one time csr
+// cycle, 100ns on QEMU. the time stands still until clock_init
+uint64_t clock_gettime_nsec(void) { return (timebase != 0) ? get_cycles() * (10000000 / timebase) : 0; }
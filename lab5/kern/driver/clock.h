@@ -7,5 +7,7 @@ extern volatile size_t ticks;
 
 void clock_init(void);
 void clock_set_next_event(void);
+uint64_t clock_gettime_msec(void);
+uint64_t clock_gettime_nsec(void);
 
 #endif /* !__KERN_DRIVER_CLOCK_H__ */
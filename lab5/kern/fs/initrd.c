@@ -0,0 +1,90 @@
+#include <defs.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <initrd.h>
+
+/* *
+ * Programs are found in the initrd by name with one hash lookup, and exec
+ * loads them straight from the image, which stays where the kernel was
+ * loaded: nothing is copied until load_icode builds the process memory.
+ * */
+
+// put at a page boundary by tools/kernel.ld
+extern unsigned char _binary_obj_initrd_img_start[], _binary_obj_initrd_img_size[];
+
+static struct initrd_header *initrd;
+static uint32_t *buckets;
+static struct initrd_entry *entries;
+
+static void check_initrd(void);
+
+// initrd_lookup - the file at path, with or without a leading '/'
+// return value: the entry, NULL if there is none
+struct initrd_entry *
+initrd_lookup(const char *path)
+{
+    while (*path == '/')
+    {
+        path++;
+    }
+    uint32_t hash = initrd_hash(path), i;
+    for (i = buckets[hash & (initrd->nr_buckets - 1)]; i != INITRD_NONE; i = entries[i].next)
+    {
+        if (entries[i].hash == hash && strcmp(entries[i].name, path) == 0)
+        {
+            return entries + i;
+        }
+    }
+    return NULL;
+}
+
+// initrd_data - the content of a file, in place in the image
+unsigned char *
+initrd_data(struct initrd_entry *entry)
+{
+    return (unsigned char *)initrd + entry->offset;
+}
+
+void print_initrd(void)
+{
+    uint32_t i;
+    cprintf("initrd: %d files, %d bytes at 0x%08lx\n", initrd->nr_files, initrd->size, initrd);
+    for (i = 0; i < initrd->nr_files; i++)
+    {
+        cprintf("  %-16s %8d\n", entries[i].name, entries[i].size);
+    }
+}
+
+// initrd_init - find the initrd linked into the kernel and check it
+void initrd_init(void)
+{
+    initrd = (struct initrd_header *)_binary_obj_initrd_img_start;
+    if ((uintptr_t)_binary_obj_initrd_img_size < sizeof(struct initrd_header) ||
+        initrd->magic != INITRD_MAGIC || initrd->size != (uintptr_t)_binary_obj_initrd_img_size ||
+        initrd->nr_buckets == 0 || (initrd->nr_buckets & (initrd->nr_buckets - 1)) != 0)
+    {
+        panic("initrd_init: bad initrd image.\n");
+    }
+    buckets = (uint32_t *)(initrd + 1);
+    entries = (struct initrd_entry *)(buckets + initrd->nr_buckets);
+    check_initrd();
+}
+
+static void
+check_initrd(void)
+{
+    uint32_t i;
+    assert(initrd->nr_files > 0 && (uintptr_t)initrd % INITRD_ALIGN == 0);
+    for (i = 0; i < initrd->nr_files; i++)
+    {
+        struct initrd_entry *entry = entries + i;
+        assert(entry->offset % INITRD_ALIGN == 0 && entry->offset + entry->size <= initrd->size);
+        assert(initrd_lookup(entry->name) == entry);
+    }
+    char path[INITRD_NAME_LEN + 3] = "//";
+    strcpy(path + 2, entries[0].name);
+    assert(initrd_lookup(path) == entries);
+    assert(initrd_lookup("") == NULL && initrd_lookup("/no/such/file") == NULL);
+    cprintf("check_initrd() succeeded!\n");
+}
@@ -0,0 +1,55 @@
+#ifndef __KERN_FS_INITRD_H__
+#define __KERN_FS_INITRD_H__
+
+#include <defs.h>
+
+/* *
+ * The initial ramdisk, built by tools/mkinitrd.c from every user program
+ * and linked into the kernel image. Layout, keep in sync with the tool:
+ *
+ *   struct initrd_header
+ *   uint32_t buckets[nr_buckets]       the first entry hashing there, or INITRD_NONE
+ *   struct initrd_entry entries[nr_files]
+ *   file data, each at an INITRD_ALIGN boundary
+ * */
+
+#define INITRD_MAGIC 0x44525449 // "ITRD"
+#define INITRD_NAME_LEN 31      // the longest name of a file
+#define INITRD_ALIGN 8          // file data alignment
+#define INITRD_NONE 0xffffffff  // end of a hash chain
+
+struct initrd_header
+{
+    uint32_t magic;      // INITRD_MAGIC
+    uint32_t nr_files;   // entries
+    uint32_t nr_buckets; // a power of 2
+    uint32_t size;       // bytes of the whole image
+};
+
+struct initrd_entry
+{
+    char name[INITRD_NAME_LEN + 1]; // NUL padded
+    uint32_t offset;                // data offset from the image start
+    uint32_t size;                  // data bytes
+    uint32_t hash;                  // initrd_hash(name)
+    uint32_t next;                  // next entry of the same bucket, or INITRD_NONE
+};
+
+// initrd_hash - 32-bit FNV-1a of a file name
+static inline uint32_t
+initrd_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name != '\0')
+    {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+void initrd_init(void);
+struct initrd_entry *initrd_lookup(const char *path);
+unsigned char *initrd_data(struct initrd_entry *entry);
+void print_initrd(void);
+
+#endif /* !__KERN_FS_INITRD_H__ */
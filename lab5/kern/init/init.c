@@ -10,8 +10,11 @@
 #include <pmm.h>
 #include <vmm.h>
 #include <proc.h>
+#include <sched.h>
 #include <kmonitor.h>
 #include <dtb.h>
+#include <trace.h>
+#include <initrd.h>
 
 int kern_init(void) __attribute__((noreturn));
 void grade_backtrace(void);
@@ -28,6 +31,8 @@ int kern_init(void)
 
     print_kerninfo();
 
+    trace_init(); // init kernel event tracing
+
     // grade_backtrace();
 
     pmm_init(); // init physical memory management
@@ -35,8 +40,10 @@ int kern_init(void)
     pic_init(); // init interrupt controller
     idt_init(); // init interrupt descriptor table
 
-    vmm_init();  // init virtual memory management
-    proc_init(); // init process table
+    vmm_init();    // init virtual memory management
+    initrd_init(); // init the initial ramdisk of user programs
+    sched_init();  // init scheduler
+    proc_init();   // init process table
 
     clock_init();  // init clock interrupt
     intr_enable(); // enable irq interrupt
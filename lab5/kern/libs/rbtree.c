@@ -0,0 +1,267 @@
+#include <defs.h>
+#include <rbtree.h>
+
+// rb_set_child - put child where old was under parent, or at the root
+static inline void
+rb_set_child(struct rb_node *parent, struct rb_node *old, struct rb_node *child, struct rb_root *root)
+{
+    if (parent == NULL)
+    {
+        root->rb_node = child;
+    }
+    else if (parent->rb_left == old)
+    {
+        parent->rb_left = child;
+    }
+    else
+    {
+        parent->rb_right = child;
+    }
+}
+
+static void
+rb_rotate_left(struct rb_node *x, struct rb_root *root)
+{
+    struct rb_node *y = x->rb_right;
+    if ((x->rb_right = y->rb_left) != NULL)
+    {
+        y->rb_left->rb_parent = x;
+    }
+    y->rb_parent = x->rb_parent;
+    rb_set_child(x->rb_parent, x, y, root);
+    y->rb_left = x;
+    x->rb_parent = y;
+}
+
+static void
+rb_rotate_right(struct rb_node *x, struct rb_root *root)
+{
+    struct rb_node *y = x->rb_left;
+    if ((x->rb_left = y->rb_right) != NULL)
+    {
+        y->rb_right->rb_parent = x;
+    }
+    y->rb_parent = x->rb_parent;
+    rb_set_child(x->rb_parent, x, y, root);
+    y->rb_right = x;
+    x->rb_parent = y;
+}
+
+static inline bool
+rb_is_black(struct rb_node *node)
+{
+    return node == NULL || node->rb_color == RB_BLACK;
+}
+
+// rb_insert_color - rebalance the tree after node was linked in by rb_link_node
+void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *parent, *gparent, *uncle;
+    while ((parent = node->rb_parent) != NULL && parent->rb_color == RB_RED)
+    {
+        // a red parent is never the root, so there is a grandparent
+        gparent = parent->rb_parent;
+        if (parent == gparent->rb_left)
+        {
+            uncle = gparent->rb_right;
+            if (!rb_is_black(uncle))
+            {
+                parent->rb_color = uncle->rb_color = RB_BLACK;
+                gparent->rb_color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_right)
+            {
+                rb_rotate_left(parent, root);
+                node = parent, parent = node->rb_parent;
+            }
+            parent->rb_color = RB_BLACK;
+            gparent->rb_color = RB_RED;
+            rb_rotate_right(gparent, root);
+        }
+        else
+        {
+            uncle = gparent->rb_left;
+            if (!rb_is_black(uncle))
+            {
+                parent->rb_color = uncle->rb_color = RB_BLACK;
+                gparent->rb_color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_left)
+            {
+                rb_rotate_right(parent, root);
+                node = parent, parent = node->rb_parent;
+            }
+            parent->rb_color = RB_BLACK;
+            gparent->rb_color = RB_RED;
+            rb_rotate_left(gparent, root);
+        }
+    }
+    root->rb_node->rb_color = RB_BLACK;
+}
+
+// rb_erase_color - rebalance the tree after a black node was taken out above
+//                - node, which may be NULL, the child of parent
+static void
+rb_erase_color(struct rb_node *node, struct rb_node *parent, struct rb_root *root)
+{
+    struct rb_node *sibling;
+    while (node != root->rb_node && rb_is_black(node))
+    {
+        // node is one black short, so its sibling is not NULL
+        if (node == parent->rb_left)
+        {
+            sibling = parent->rb_right;
+            if (!rb_is_black(sibling))
+            {
+                sibling->rb_color = RB_BLACK;
+                parent->rb_color = RB_RED;
+                rb_rotate_left(parent, root);
+                sibling = parent->rb_right;
+            }
+            if (rb_is_black(sibling->rb_left) && rb_is_black(sibling->rb_right))
+            {
+                sibling->rb_color = RB_RED;
+                node = parent, parent = node->rb_parent;
+                continue;
+            }
+            if (rb_is_black(sibling->rb_right))
+            {
+                sibling->rb_left->rb_color = RB_BLACK;
+                sibling->rb_color = RB_RED;
+                rb_rotate_right(sibling, root);
+                sibling = parent->rb_right;
+            }
+            sibling->rb_color = parent->rb_color;
+            parent->rb_color = RB_BLACK;
+            sibling->rb_right->rb_color = RB_BLACK;
+            rb_rotate_left(parent, root);
+        }
+        else
+        {
+            sibling = parent->rb_left;
+            if (!rb_is_black(sibling))
+            {
+                sibling->rb_color = RB_BLACK;
+                parent->rb_color = RB_RED;
+                rb_rotate_right(parent, root);
+                sibling = parent->rb_left;
+            }
+            if (rb_is_black(sibling->rb_left) && rb_is_black(sibling->rb_right))
+            {
+                sibling->rb_color = RB_RED;
+                node = parent, parent = node->rb_parent;
+                continue;
+            }
+            if (rb_is_black(sibling->rb_left))
+            {
+                sibling->rb_right->rb_color = RB_BLACK;
+                sibling->rb_color = RB_RED;
+                rb_rotate_left(sibling, root);
+                sibling = parent->rb_left;
+            }
+            sibling->rb_color = parent->rb_color;
+            parent->rb_color = RB_BLACK;
+            sibling->rb_left->rb_color = RB_BLACK;
+            rb_rotate_right(parent, root);
+        }
+        node = root->rb_node;
+        break;
+    }
+    if (node != NULL)
+    {
+        node->rb_color = RB_BLACK;
+    }
+}
+
+// rb_erase - take node out of the tree
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *child, *parent;
+    int color;
+    if (node->rb_left == NULL || node->rb_right == NULL)
+    {
+        child = (node->rb_left != NULL) ? node->rb_left : node->rb_right;
+        parent = node->rb_parent;
+        color = node->rb_color;
+        rb_set_child(parent, node, child, root);
+        if (child != NULL)
+        {
+            child->rb_parent = parent;
+        }
+    }
+    else
+    {
+        // the next node, with no left child, takes the place of node
+        struct rb_node *next = node->rb_right;
+        while (next->rb_left != NULL)
+        {
+            next = next->rb_left;
+        }
+        child = next->rb_right;
+        color = next->rb_color;
+        if (next->rb_parent == node)
+        {
+            parent = next;
+        }
+        else
+        {
+            parent = next->rb_parent;
+            parent->rb_left = child;
+            if (child != NULL)
+            {
+                child->rb_parent = parent;
+            }
+            next->rb_right = node->rb_right;
+            node->rb_right->rb_parent = next;
+        }
+        rb_set_child(node->rb_parent, node, next, root);
+        next->rb_parent = node->rb_parent;
+        next->rb_left = node->rb_left;
+        node->rb_left->rb_parent = next;
+        next->rb_color = node->rb_color;
+    }
+    if (color == RB_BLACK)
+    {
+        rb_erase_color(child, parent, root);
+    }
+}
+
+// rb_first - the least node of the tree, NULL if it is empty
+struct rb_node *
+rb_first(struct rb_root *root)
+{
+    struct rb_node *node = root->rb_node;
+    if (node != NULL)
+    {
+        while (node->rb_left != NULL)
+        {
+            node = node->rb_left;
+        }
+    }
+    return node;
+}
+
+// rb_next - the node after node in the tree, NULL if it is the last one
+struct rb_node *
+rb_next(struct rb_node *node)
+{
+    if (node->rb_right != NULL)
+    {
+        node = node->rb_right;
+        while (node->rb_left != NULL)
+        {
+            node = node->rb_left;
+        }
+        return node;
+    }
+    struct rb_node *parent;
+    while ((parent = node->rb_parent) != NULL && node == parent->rb_right)
+    {
+        node = parent;
+    }
+    return parent;
+}
@@ -0,0 +1,45 @@
+#ifndef __KERN_LIBS_RBTREE_H__
+#define __KERN_LIBS_RBTREE_H__
+
+#include <defs.h>
+
+/* *
+ * Red-black tree, with the nodes embedded in the structures kept in the
+ * tree, like list_entry_t. The tree does not know the order of its nodes:
+ * the caller walks down from the root to the place of a new node, links it
+ * there with rb_link_node and then rebalances with rb_insert_color.
+ * */
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+struct rb_node
+{
+    struct rb_node *rb_parent, *rb_left, *rb_right;
+    int rb_color;
+};
+
+struct rb_root
+{
+    struct rb_node *rb_node;
+};
+
+#define rb_entry(node, type, member) \
+    to_struct((node), type, member)
+
+// rb_link_node - put node, red, at *link, a NULL child of parent
+static inline void
+rb_link_node(struct rb_node *node, struct rb_node *parent, struct rb_node **link)
+{
+    node->rb_parent = parent;
+    node->rb_left = node->rb_right = NULL;
+    node->rb_color = RB_RED;
+    *link = node;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+struct rb_node *rb_first(struct rb_root *root);
+struct rb_node *rb_next(struct rb_node *node);
+
+#endif /* !__KERN_LIBS_RBTREE_H__ */
@@ -0,0 +1,333 @@
+#include <defs.h>
+#include <list.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sync.h>
+#include <kmalloc.h>
+#include <pmm.h>
+#include <vmm.h>
+#include <proc.h>
+#include <ksm.h>
+#include <trace.h>
+
+/* *
+ * Same-page merging. The kernel thread ksmd walks the private memory of every
+ * process a few ptes at a time, and lets the ptes of pages with the same
+ * contents map one frame, read-only and PTE_COW, so that a write copies it
+ * in do_pgfault just like a page shared by fork.
+ *
+ * A merged frame is a stable frame: the stable table holds a reference of its
+ * own on it, so do_pgfault never finds it the only reference of a pte and
+ * always copies it, and its contents never change. Private pages are just
+ * hashed into the unstable table: a page whose hash was already met in this
+ * pass becomes a stable frame in place, and the pages with the same contents
+ * met after it merge into it, in this pass or in the next one for those met
+ * before. The unstable table is cleared, and stable frames nobody maps any
+ * more are freed, at the end of each pass.
+ * */
+
+#define KSM_HASH_SIZE 256      // buckets of the stable table
+#define KSM_UNSTABLE_SIZE 1024 // hashes of private pages remembered per pass
+#define KSM_UNSTABLE_PROBE 8   // slots looked at per lookup of the unstable table
+
+struct ksm_page
+{
+    struct Page *page;      // the stable frame
+    uint32_t hash;          // ksm_hash of its contents
+    list_entry_t hash_link; // stable table bucket link
+};
+
+#define le2ksm(le, member) \
+    to_struct((le), struct ksm_page, member)
+
+static list_entry_t stable_table[KSM_HASH_SIZE];
+static size_t nr_stable;
+// hashes met in this pass, 0 for a free slot
+static uint32_t unstable_table[KSM_UNSTABLE_SIZE];
+static uint32_t zero_hash;
+
+struct ksm_stats ksm_stats;
+volatile bool ksm_run = 1;
+static volatile bool ksm_exit;
+
+// ksm_hash - FNV-1a of the contents of page, never 0
+static uint32_t
+ksm_hash(struct Page *page)
+{
+    const uint32_t *p = page2kva(page);
+    uint32_t hash = 2166136261u;
+    int i;
+    for (i = 0; i < PGSIZE / sizeof(uint32_t); i++)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return (hash != 0) ? hash : 1;
+}
+
+// unstable_seen - record hash in the unstable table, return if it was there already
+static bool
+unstable_seen(uint32_t hash)
+{
+    size_t i, slot = hash % KSM_UNSTABLE_SIZE;
+    for (i = 0; i < KSM_UNSTABLE_PROBE; i++, slot = (slot + 1) % KSM_UNSTABLE_SIZE)
+    {
+        if (unstable_table[slot] == hash)
+        {
+            return 1;
+        }
+        if (unstable_table[slot] == 0)
+        {
+            unstable_table[slot] = hash;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// stable_find - find the stable frame with the same contents as page
+static struct ksm_page *
+stable_find(struct Page *page, uint32_t hash)
+{
+    list_entry_t *list = &stable_table[hash % KSM_HASH_SIZE], *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct ksm_page *kp = le2ksm(le, hash_link);
+        if (kp->hash == hash && memcmp(page2kva(kp->page), page2kva(page), PGSIZE) == 0)
+        {
+            return kp;
+        }
+    }
+    return NULL;
+}
+
+// ksm_replace - let the pte at ptep map frame read-only and PTE_COW instead of its page
+static void
+ksm_replace(pte_t *ptep, struct Page *frame)
+{
+    struct Page *page = pte2page(*ptep);
+    page_ref_inc(frame);
+    *ptep = pte_create(page2ppn(frame), ((*ptep & PTE_USER) & ~PTE_W) | PTE_COW);
+    if (page_ref_dec(page) == 0)
+    {
+        free_page(page);
+    }
+}
+
+// ksm_scan_pte - merge the page mapped by *ptep if it is private to it
+//              - the PT may be shared by fork: the pte then stands for all
+//              - the sharers, which see the same contents either way
+static void
+ksm_scan_pte(pte_t *ptep)
+{
+    if ((*ptep & (PTE_V | PTE_U)) != (PTE_V | PTE_U))
+    {
+        return;
+    }
+    struct Page *page = pte2page(*ptep);
+    if (page == zero_page || page_ref(page) != 1)
+    {
+        return;
+    }
+
+    uint32_t hash = ksm_hash(page);
+    struct ksm_page *kp;
+    if (hash == zero_hash && memcmp(page2kva(page), page2kva(zero_page), PGSIZE) == 0)
+    {
+        ksm_replace(ptep, zero_page);
+        ksm_stats.zeroed++;
+    }
+    else if ((kp = stable_find(page, hash)) != NULL)
+    {
+        ksm_replace(ptep, kp->page);
+        ksm_stats.merged++;
+    }
+    else if (unstable_seen(hash) && (kp = kmalloc(sizeof(struct ksm_page))) != NULL)
+    {
+        kp->page = page;
+        kp->hash = hash;
+        page_ref_inc(page);
+        *ptep = (*ptep & ~PTE_W) | PTE_COW;
+        list_add(&stable_table[hash % KSM_HASH_SIZE], &(kp->hash_link));
+        nr_stable++;
+        ksm_stats.promoted++;
+    }
+}
+
+// ksm_scan_mm - scan the private vmas of mm from *addr_store on, a pte or a
+//             - missing PT costing one unit of *budget
+// return value: 1 if the end of mm was reached, else *addr_store is where to go on
+bool ksm_scan_mm(struct mm_struct *mm, uintptr_t *addr_store, size_t *budget)
+{
+    uintptr_t la = *addr_store;
+    bool done = 1;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        if (vma->vm_end <= la || (vma->vm_flags & VM_SHARED))
+        {
+            continue;
+        }
+        la = (la > vma->vm_start) ? la : vma->vm_start;
+        while (la < vma->vm_end)
+        {
+            if (*budget == 0)
+            {
+                done = 0;
+                goto out;
+            }
+            (*budget)--;
+            pte_t *ptep = get_pte(mm->pgdir, la, 0);
+            if (ptep == NULL)
+            {
+                la = ROUNDDOWN(la, PTSIZE) + PTSIZE;
+                continue;
+            }
+            ksm_scan_pte(ptep);
+            ksm_stats.scanned++;
+            la += PGSIZE;
+        }
+    }
+out:
+    flush_tlb();
+    *addr_store = la;
+    return done;
+}
+
+// ksm_pass_end - forget the hashes of this pass and free the stable frames
+//              - only the stable table still holds
+void ksm_pass_end(void)
+{
+    memset(unstable_table, 0, sizeof(unstable_table));
+    int i;
+    for (i = 0; i < KSM_HASH_SIZE; i++)
+    {
+        list_entry_t *list = &stable_table[i], *le = list_next(list);
+        while (le != list)
+        {
+            struct ksm_page *kp = le2ksm(le, hash_link);
+            le = list_next(le);
+            if (page_ref(kp->page) == 1)
+            {
+                page_ref_dec(kp->page);
+                free_page(kp->page);
+                list_del(&(kp->hash_link));
+                kfree(kp);
+                nr_stable--;
+                ksm_stats.pruned++;
+            }
+        }
+    }
+    ksm_stats.passes++;
+    trace(TRACE_DEBUG, TRACE_MM, "ksm: pass %d done, %d stable frames\n", ksm_stats.passes, nr_stable);
+}
+
+// ksm_next_proc - the process with the smallest pid no less than pid which
+//               - has user memory of its own, NULL if none
+static struct proc_struct *
+ksm_next_proc(int pid)
+{
+    struct proc_struct *next = NULL;
+    list_entry_t *le = &proc_list;
+    while ((le = list_next(le)) != &proc_list)
+    {
+        struct proc_struct *proc = le2proc(le, list_link);
+        if (proc->pid >= pid && proc->mm != NULL && !(proc->flags & (PF_EXITING | PF_VFORK)) &&
+            (next == NULL || proc->pid < next->pid))
+        {
+            next = proc;
+        }
+    }
+    return next;
+}
+
+// ksmd - scan KSM_PAGES_TO_SCAN ptes, in pid and address order, every
+//      - KSM_SLEEP_TICKS ticks. an mm somebody holds locked is retried later
+static int
+ksmd(void *arg)
+{
+    int pid = 0;
+    uintptr_t addr = 0;
+    while (!ksm_exit)
+    {
+        size_t budget = KSM_PAGES_TO_SCAN;
+        while (ksm_run && budget > 0)
+        {
+            struct proc_struct *proc = ksm_next_proc(pid);
+            if (proc == NULL)
+            {
+                ksm_pass_end();
+                pid = 0, addr = 0;
+                break;
+            }
+            if (proc->pid != pid)
+            {
+                pid = proc->pid, addr = 0;
+            }
+            struct mm_struct *mm = proc->mm;
+            if (!mutex_trylock(&(mm->mm_lock)))
+            {
+                break;
+            }
+            if (ksm_scan_mm(mm, &addr, &budget))
+            {
+                pid++, addr = 0;
+            }
+            mutex_unlock(&(mm->mm_lock));
+        }
+        do_sleep(KSM_SLEEP_TICKS);
+    }
+    ksm_pass_end();
+    return 0;
+}
+
+void ksm_init(void)
+{
+    int i;
+    for (i = 0; i < KSM_HASH_SIZE; i++)
+    {
+        list_init(stable_table + i);
+    }
+    zero_hash = ksm_hash(zero_page);
+}
+
+// ksm_start - create the ksmd kernel thread
+int ksm_start(void)
+{
+    int pid = kernel_thread(ksmd, NULL, 0);
+    if (pid > 0)
+    {
+        set_proc_name(find_proc(pid), "ksmd");
+    }
+    return pid;
+}
+
+// ksm_stop - let ksmd exit when it wakes up next
+void ksm_stop(void)
+{
+    ksm_exit = 1;
+}
+
+// print_ksm_stats - print the ksmd counters and the pages merging saves now
+void print_ksm_stats(void)
+{
+    size_t sharing = 0, saved = 0;
+    int i;
+    for (i = 0; i < KSM_HASH_SIZE; i++)
+    {
+        list_entry_t *list = &stable_table[i], *le = list;
+        while ((le = list_next(le)) != list)
+        {
+            // the stable table holds one reference, one mapping saves nothing
+            int ref = page_ref(le2ksm(le, hash_link)->page);
+            sharing += ref - 1;
+            saved += (ref > 2) ? ref - 2 : 0;
+        }
+    }
+    cprintf("ksm: %s, %llu passes, %llu ptes scanned\n", ksm_run ? "running" : "paused",
+            ksm_stats.passes, ksm_stats.scanned);
+    cprintf("  stable frames %llu, mapped %llu times, pages saved %llu\n", nr_stable, sharing, saved);
+    cprintf("  merged %llu, into the zero page %llu, promoted %llu, pruned %llu\n",
+            ksm_stats.merged, ksm_stats.zeroed, ksm_stats.promoted, ksm_stats.pruned);
+}
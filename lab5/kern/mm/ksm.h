@@ -0,0 +1,32 @@
+#ifndef __KERN_MM_KSM_H__
+#define __KERN_MM_KSM_H__
+
+#include <defs.h>
+
+struct mm_struct;
+
+#define KSM_PAGES_TO_SCAN 128 // ptes ksmd looks at per wakeup
+#define KSM_SLEEP_TICKS 2     // clock ticks ksmd sleeps between two batches
+
+// counters of the same-page merging thread ksmd
+struct ksm_stats
+{
+    size_t scanned;  // ptes looked at
+    size_t merged;   // private pages replaced by a stable frame
+    size_t zeroed;   // zero-filled private pages replaced by the zero page
+    size_t promoted; // private pages turned into stable frames
+    size_t pruned;   // stable frames freed after their last mapping went away
+    size_t passes;   // passes over the memory of all processes
+};
+
+extern struct ksm_stats ksm_stats;
+extern volatile bool ksm_run;
+
+void ksm_init(void);
+int ksm_start(void);
+void ksm_stop(void);
+bool ksm_scan_mm(struct mm_struct *mm, uintptr_t *addr_store, size_t *budget);
+void ksm_pass_end(void);
+void print_ksm_stats(void);
+
+#endif /* !__KERN_MM_KSM_H__ */
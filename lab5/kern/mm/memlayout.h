@@ -64,6 +64,8 @@
 #define USTACKTOP USERTOP
 #define USTACKPAGE 256                   // # of pages in user stack
 #define USTACKSIZE (USTACKPAGE * PGSIZE) // sizeof user stack
+#define USTACKGUARDPAGE 1                          // # of unmapped pages kept below the stack
+#define USTACKGUARDSIZE (USTACKGUARDPAGE * PGSIZE) // sizeof the stack guard region
 
 #define USERBASE 0x00200000
 #define UTEXT 0x00800000 // where user programs generally begin
@@ -12,6 +12,7 @@
 #include <sync.h>
 #include <vmm.h>
 #include <riscv.h>
+#include <trace.h>
 
 // virtual address of physical page array
 struct Page *pages;
@@ -30,6 +31,9 @@ uintptr_t boot_pgdir_pa;
 // physical memory management
 const struct pmm_manager *pmm_manager;
 
+// the caches alloc_pages may shrink
+static list_entry_t shrinker_list = {&shrinker_list, &shrinker_list};
+
 static void check_alloc_page(void);
 static void check_pgdir(void);
 static void check_boot_pgdir(void);
@@ -49,7 +53,7 @@ static void init_memmap(struct Page *base, size_t n)
 }
 
 // alloc_pages - call pmm->alloc_pages to allocate a continuous n*PAGESIZE
-// memory
+// memory, shrinking the caches and trying once more if there is none
 struct Page *alloc_pages(size_t n)
 {
     struct Page *page = NULL;
@@ -59,9 +63,37 @@ struct Page *alloc_pages(size_t n)
         page = pmm_manager->alloc_pages(n);
     }
     local_intr_restore(intr_flag);
+    if (page == NULL && shrink_caches(n) != 0)
+    {
+        local_intr_save(intr_flag);
+        {
+            page = pmm_manager->alloc_pages(n);
+        }
+        local_intr_restore(intr_flag);
+    }
     return page;
 }
 
+// register_shrinker - let alloc_pages take pages back from a cache
+void register_shrinker(struct shrinker *shrinker)
+{
+    list_add_before(&shrinker_list, &(shrinker->shrinker_link));
+}
+
+// shrink_caches - ask the shrinkers in turn to free nr_pages in all
+// return value: the pages freed
+size_t shrink_caches(size_t nr_pages)
+{
+    size_t freed = 0;
+    list_entry_t *le = &shrinker_list;
+    while (freed < nr_pages && (le = list_next(le)) != &shrinker_list)
+    {
+        struct shrinker *shrinker = to_struct(le, struct shrinker, shrinker_link);
+        freed += shrinker->shrink(nr_pages - freed);
+    }
+    return freed;
+}
+
 // free_pages - call pmm->free_pages to free a continuous n*PAGESIZE memory
 void free_pages(struct Page *base, size_t n)
 {
@@ -211,14 +243,9 @@ void pmm_init(void)
     kmalloc_init();
 }
 
-// get_pte - get pte and return the kernel virtual address of this pte for la
-//        - if the PT contians this pte didn't exist, alloc a page for PT
-// parameter:
-//  pgdir:  the kernel virtual base address of PDT
-//  la:     the linear address need to map
-//  create: a logical value to decide if alloc a page for PT
-// return vaule: the kernel virtual address of this pte
-pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
+// get_pde0 - get the level 0 page directory entry, which points to the PT for la
+//          - if the level 0 page directory didn't exist and create, alloc a page for it
+static pde_t *get_pde0(pde_t *pgdir, uintptr_t la, bool create)
 {
     pde_t *pdep1 = &pgdir[PDX1(la)];
     if (!(*pdep1 & PTE_V))
@@ -233,8 +260,72 @@ pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
         memset(KADDR(pa), 0, PGSIZE);
         *pdep1 = pte_create(page2ppn(page), PTE_U | PTE_V);
     }
+    return &((pde_t *)KADDR(PDE_ADDR(*pdep1)))[PDX0(la)];
+}
+
+/* *
+ * PT sharing: fork lets the child use the parent's PTs (see share_pt) instead
+ * of copying every pte. The ref of a PT page counts the page tables using it,
+ * while the ref of a data page mapped by a shared PT counts that PT only once.
+ * A shared PT is never written: get_pte(create) and unmap_range give the page
+ * table a private copy first (unshare_pt), which also takes a reference on
+ * every page the PT maps.
+ * */
+static inline bool pt_shared(pde_t pde0)
+{
+    return page_ref(pde2page(pde0)) > 1;
+}
 
-    pde_t *pdep0 = &((pde_t *)KADDR(PDE_ADDR(*pdep1)))[PDX0(la)];
+// unshare_pt - replace the shared PT pointed to by *pdep0 with a private copy
+static int unshare_pt(pde_t *pdep0)
+{
+    struct Page *opt = pde2page(*pdep0), *npt;
+    if ((npt = alloc_page()) == NULL)
+    {
+        return -E_NO_MEM;
+    }
+    set_page_ref(npt, 1);
+    pte_t *src = page2kva(opt), *dst = page2kva(npt);
+    int i;
+    for (i = 0; i < NPTEENTRY; i++)
+    {
+        if ((dst[i] = src[i]) & PTE_V)
+        {
+            page_ref_inc(pte2page(src[i]));
+        }
+    }
+    page_ref_dec(opt);
+    *pdep0 = pte_create(page2ppn(npt), PTE_U | PTE_V);
+    flush_tlb();
+    return 0;
+}
+
+// put_pt - drop the reference the page table holds on the PT pointed to by *pdep0
+static void put_pt(pde_t *pdep0)
+{
+    struct Page *pt = pde2page(*pdep0);
+    if (page_ref_dec(pt) == 0)
+    {
+        free_page(pt);
+    }
+    *pdep0 = 0;
+}
+
+// get_pte - get pte and return the kernel virtual address of this pte for la
+//        - if the PT contians this pte didn't exist, alloc a page for PT
+//        - if create, the PT is private to pgdir, a PT shared by fork is copied
+// parameter:
+//  pgdir:  the kernel virtual base address of PDT
+//  la:     the linear address need to map
+//  create: a logical value to decide if alloc a page for PT
+// return vaule: the kernel virtual address of this pte
+pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
+{
+    pde_t *pdep0 = get_pde0(pgdir, la, create);
+    if (pdep0 == NULL)
+    {
+        return NULL;
+    }
     if (!(*pdep0 & PTE_V))
     {
         struct Page *page;
@@ -247,9 +338,81 @@ pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create)
         memset(KADDR(pa), 0, PGSIZE);
         *pdep0 = pte_create(page2ppn(page), PTE_U | PTE_V);
     }
+    else if (create && pt_shared(*pdep0) && unshare_pt(pdep0) != 0)
+    {
+        return NULL;
+    }
     return &((pte_t *)KADDR(PDE_ADDR(*pdep0)))[PTX(la)];
 }
 
+// share_pt - let to use the PT of from for the PTSIZE chunk containing la
+//          - writable ptes are turned into read-only PTE_COW ones, so a write
+//          - in either address space faults and unshares the PT first.
+//          - the chunk must not hold VM_SHARED pages
+int share_pt(pde_t *to, pde_t *from, uintptr_t la)
+{
+    pde_t *fpdep0 = get_pde0(from, la, 0), *tpdep0;
+    if (fpdep0 == NULL || !(*fpdep0 & PTE_V))
+    {
+        return 0;
+    }
+    if ((tpdep0 = get_pde0(to, la, 1)) == NULL)
+    {
+        return -E_NO_MEM;
+    }
+    if (*tpdep0 & PTE_V)
+    {
+        // already shared while copying a previous vma in this chunk
+        if (*tpdep0 == *fpdep0)
+        {
+            return 0;
+        }
+        // or an empty PT kept by mm_recycle, which makes room for the shared one
+        assert(!pt_shared(*tpdep0));
+        put_pt(tpdep0);
+    }
+    struct Page *pt = pde2page(*fpdep0);
+    if (!pt_shared(*fpdep0))
+    {
+        pte_t *ptep = page2kva(pt);
+        int i;
+        for (i = 0; i < NPTEENTRY; i++)
+        {
+            if ((ptep[i] & (PTE_V | PTE_W)) == (PTE_V | PTE_W))
+            {
+                ptep[i] = (ptep[i] & ~PTE_W) | PTE_COW;
+            }
+        }
+    }
+    page_ref_inc(pt);
+    *tpdep0 = *fpdep0;
+    trace(TRACE_DEBUG, TRACE_FORK, "share_pt: 0x%x, pt ref %d\n", ROUNDDOWN(la, PTSIZE), page_ref(pt));
+    return 0;
+}
+
+// detach_shared_pts - drop the PTs in [start, end) which pgdir shares with
+//                   - other page tables, without copying them
+//                   - [start, end) is rounded out to whole PTs
+void detach_shared_pts(pde_t *pgdir, uintptr_t start, uintptr_t end)
+{
+    start = ROUNDDOWN(start, PTSIZE);
+    do
+    {
+        pde_t *pdep0 = get_pde0(pgdir, start, 0);
+        if (pdep0 == NULL)
+        {
+            start = ROUNDDOWN(start + PDSIZE, PDSIZE);
+            continue;
+        }
+        if ((*pdep0 & PTE_V) && pt_shared(*pdep0))
+        {
+            put_pt(pdep0);
+        }
+        start += PTSIZE;
+    } while (start != 0 && start < end);
+    flush_tlb();
+}
+
 // get_page - get related Page struct for linear address la using PDT pgdir
 struct Page *get_page(pde_t *pgdir, uintptr_t la, pte_t **ptep_store)
 {
@@ -283,25 +446,44 @@ static inline void page_remove_pte(pde_t *pgdir, uintptr_t la, pte_t *ptep)
     }
 }
 
-void unmap_range(pde_t *pgdir, uintptr_t start, uintptr_t end)
+// unmap_range - remove the pages mapped in [start, end)
+//             - a shared PT wholly inside the range is just dropped, one only
+//             - partly inside is unshared first, which may fail with -E_NO_MEM
+int unmap_range(pde_t *pgdir, uintptr_t start, uintptr_t end)
 {
     assert(start % PGSIZE == 0 && end % PGSIZE == 0);
     assert(USER_ACCESS(start, end));
 
     do
     {
-        pte_t *ptep = get_pte(pgdir, start, 0);
-        if (ptep == NULL)
+        pde_t *pdep0 = get_pde0(pgdir, start, 0);
+        if (pdep0 == NULL || !(*pdep0 & PTE_V))
         {
             start = ROUNDDOWN(start + PTSIZE, PTSIZE);
             continue;
         }
+        if (pt_shared(*pdep0))
+        {
+            if (start % PTSIZE == 0 && start + PTSIZE <= end)
+            {
+                put_pt(pdep0);
+                flush_tlb();
+                start += PTSIZE;
+                continue;
+            }
+            if (unshare_pt(pdep0) != 0)
+            {
+                return -E_NO_MEM;
+            }
+        }
+        pte_t *ptep = &((pte_t *)KADDR(PDE_ADDR(*pdep0)))[PTX(start)];
         if (*ptep != 0)
         {
             page_remove_pte(pgdir, start, ptep);
         }
         start += PGSIZE;
     } while (start != 0 && start < end);
+    return 0;
 }
 
 void exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end)
@@ -310,7 +492,7 @@ void exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end)
     assert(USER_ACCESS(start, end));
 
     uintptr_t d1start, d0start;
-    int free_pt, free_pd0;
+    int free_pt, free_pd0, i;
     pde_t *pd0, *pt, pde1, pde0;
     d1start = ROUNDDOWN(start, PDSIZE);
     d0start = ROUNDDOWN(start, PTSIZE);
@@ -327,7 +509,6 @@ void exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end)
         {
             pd0 = page2kva(pde2page(pde1));
             // try to free all page tables
-            free_pd0 = 1;
             do
             {
                 pde0 = pd0[PDX0(d0start)];
@@ -336,24 +517,30 @@ void exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end)
                     pt = page2kva(pde2page(pde0));
                     // try to free page table
                     free_pt = 1;
-                    for (int i = 0; i < NPTEENTRY; i++)
+                    for (i = 0; i < NPTEENTRY; i++)
                         if (pt[i] & PTE_V)
                         {
                             free_pt = 0;
                             break;
                         }
-                    // free it only when all entry are already invalid
+                    // free it only when all entry are already invalid,
+                    // a shared PT is freed by the last page table using it
                     if (free_pt)
                     {
-                        free_page(pde2page(pde0));
-                        pd0[PDX0(d0start)] = 0;
+                        put_pt(&pd0[PDX0(d0start)]);
                     }
                 }
-                else
-                    free_pd0 = 0;
                 d0start += PTSIZE;
             } while (d0start != 0 && d0start < d1start + PDSIZE && d0start < end);
-            // free level 0 page directory only when all pde0s in it are already invalid
+            // free level 0 page directory only when all pde0s in it are already invalid,
+            // including those outside [start, end) still pointing to live page tables
+            free_pd0 = 1;
+            for (i = 0; i < NPTEENTRY; i++)
+                if (pd0[i] & PTE_V)
+                {
+                    free_pd0 = 0;
+                    break;
+                }
             if (free_pd0)
             {
                 free_page(pde2page(pde1));
@@ -368,15 +555,16 @@ void exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end)
  * process B
  * @to:    the addr of process B's Page Directory
  * @from:  the addr of process A's Page Directory
- * @share: flags to indicate to dup OR share. We just use dup method, so it
- * didn't be used.
+ * @share: flags to indicate to dup OR share. if share, B maps the same frames
+ * with the same permission as A, so writes are seen by both (VM_SHARED vmas).
+ * otherwise writable pages become read-only PTE_COW pages in both A and B, and
+ * are copied on the first write by do_pgfault.
  *
  * CALL GRAPH: copy_mm-->dup_mmap-->copy_range
  */
 int copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end,
                bool share)
 {
-    cprintf("Start\n");
     assert(start % PGSIZE == 0 && end % PGSIZE == 0);
     assert(USER_ACCESS(start, end));
     // copy content by page unit.
@@ -390,15 +578,12 @@ int copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end,
             continue;
         }
         // if the page is writable, and we need to share it, then we should set the page as read-only and COW
-        if ((*ptep & PTE_V) && (*ptep & PTE_W) && share)
+        if ((*ptep & PTE_V) && (*ptep & PTE_W) && !share)
         {
-            cprintf("[DEBUG copy_range] COW candidate: addr=0x%x, *ptep=0x%x, PTE_W=%d\n", start, *ptep, (*ptep & PTE_W) != 0);
             struct Page *page = pte2page(*ptep);
             uint32_t perm = (*ptep & PTE_USER) & ~PTE_W;
-            
-            // 添加调试信息：打印原始 PTE、计算后的 perm 和最终 PTE
-            cprintf("[DEBUG copy_range] Sharing page at 0x%x, original *ptep 0x%x, perm 0x%x\n", start, *ptep, perm);
-            
+            trace(TRACE_DEBUG, TRACE_FORK, "copy_range: cow 0x%x, pte 0x%x, perm 0x%x\n", start, *ptep, perm);
+
             // 1. Insert page into child's page table with read-only and COW flags
             int ret = page_insert(to, page, start, perm | PTE_COW);
             if (ret != 0)
@@ -419,9 +604,10 @@ int copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end,
             
         }
         else if (*ptep & PTE_V) {
-            cprintf("[DEBUG copy_range] Skipping COW: addr=0x%x, *ptep=0x%x, PTE_V=%d, PTE_W=%d, share=%d\n", start, *ptep, (*ptep & PTE_V) != 0, (*ptep & PTE_W) != 0, share);
+            trace(TRACE_DEBUG, TRACE_FORK, "copy_range: map 0x%x, pte 0x%x, share %d\n", start, *ptep, share);
             struct Page *page = pte2page(*ptep);
-            int ret = page_insert(to, page, start, *ptep & PTE_USER);
+            // keep PTE_COW, a page already shared copy-on-write stays so in B
+            int ret = page_insert(to, page, start, *ptep & (PTE_USER | PTE_COW));
             if (ret != 0) {
                 return ret;
             }
@@ -6,6 +6,7 @@
 #include <memlayout.h>
 #include <atomic.h>
 #include <assert.h>
+#include <list.h>
 
 // pmm_manager is a physical memory management class. A special pmm manager - XXX_pmm_manager
 // only needs to implement the methods in pmm_manager class, then XXX_pmm_manager can be used
@@ -23,6 +24,15 @@ struct pmm_manager
     void (*check)(void);                              // check the correctness of XXX_pmm_manager
 };
 
+// a cache of free memory kept out of the allocator, e.g. the kernel stack
+// cache. alloc_pages asks the shrinkers for pages back before it fails
+struct shrinker
+{
+    const char *name;
+    size_t (*shrink)(size_t nr_pages); // free about nr_pages, return how many were freed
+    list_entry_t shrinker_link;        // all the registered shrinkers
+};
+
 extern const struct pmm_manager *pmm_manager;
 extern pde_t *boot_pgdir_va;
 extern const size_t nbase;
@@ -37,6 +47,9 @@ size_t nr_free_pages(void);
 #define alloc_page() alloc_pages(1)
 #define free_page(page) free_pages(page, 1)
 
+void register_shrinker(struct shrinker *shrinker);
+size_t shrink_caches(size_t nr_pages);
+
 pte_t *get_pte(pde_t *pgdir, uintptr_t la, bool create);
 struct Page *get_page(pde_t *pgdir, uintptr_t la, pte_t **ptep_store);
 void page_remove(pde_t *pgdir, uintptr_t la);
@@ -45,9 +58,11 @@ int page_insert(pde_t *pgdir, struct Page *page, uintptr_t la, uint32_t perm);
 void load_esp0(uintptr_t esp0);
 void tlb_invalidate(pde_t *pgdir, uintptr_t la);
 struct Page *pgdir_alloc_page(pde_t *pgdir, uintptr_t la, uint32_t perm);
-void unmap_range(pde_t *pgdir, uintptr_t start, uintptr_t end);
+int unmap_range(pde_t *pgdir, uintptr_t start, uintptr_t end);
 void exit_range(pde_t *pgdir, uintptr_t start, uintptr_t end);
 int copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end, bool share);
+int share_pt(pde_t *to, pde_t *from, uintptr_t la);
+void detach_shared_pts(pde_t *pgdir, uintptr_t start, uintptr_t end);
 
 void print_pgdir(void);
 
@@ -0,0 +1,28 @@
+#ifndef __KERN_MM_UACCESS_H__
+#define __KERN_MM_UACCESS_H__
+
+#include <defs.h>
+
+/* *
+ * The kernel runs with sstatus.SUM clear, so a stray dereference of a user
+ * pointer faults instead of silently reading user memory. User memory is only
+ * touched by the accessors in kern/mm/uaccess.S, which set SUM around the copy.
+ *
+ * Every load/store of user memory in those accessors has an entry in the
+ * __ex_table section. When a page fault taken in kernel mode cannot be
+ * resolved by do_pgfault, the trap handler looks up the faulting epc there and
+ * resumes at the fixup address instead of panicking.
+ * */
+struct exception_table_entry
+{
+    uintptr_t insn;  // address of the instruction which is allowed to fault
+    uintptr_t fixup; // address to continue at if it does
+};
+
+// __copy_user - copy len bytes between user and kernel memory
+// return value: the number of bytes NOT copied, 0 on success
+size_t __copy_user(void *dst, const void *src, size_t len);
+
+uintptr_t search_exception_table(uintptr_t epc);
+
+#endif /* !__KERN_MM_UACCESS_H__ */
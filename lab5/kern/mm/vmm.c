@@ -7,6 +7,12 @@
 #include <pmm.h>
 #include <riscv.h>
 #include <kmalloc.h>
+#include <uaccess.h>
+#include <trace.h>
+#include <ksm.h>
+#include <lockstat.h>
+#include <proc.h>
+#include <sched.h>
 
 /*
   vmm design include two parts: mm_struct (mm) & vma_struct (vma)
@@ -23,10 +29,19 @@
   vma related functions:
    global functions
      struct vma_struct * vma_create (uintptr_t vm_start, uintptr_t vm_end,...)
-     void insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma)
+     struct vma_struct * insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma)
      struct vma_struct * find_vma(struct mm_struct *mm, uintptr_t addr)
+     struct vma_struct * expand_stack(struct mm_struct *mm, uintptr_t addr)
    local functions
      inline void check_vma_overlap(struct vma_struct *prev, struct vma_struct *next)
+     struct vma_struct * find_stack_vma(struct mm_struct *mm, uintptr_t addr)
+     bool vma_merge_next(struct mm_struct *mm, struct vma_struct *vma)
+     struct vma_struct * vma_split(struct mm_struct *mm, struct vma_struct *vma, uintptr_t addr)
+---------------
+  vmas never overlap, and two neighbouring vmas are never mergeable: insert_vma_struct
+  folds a new vma into an adjacent one with the same vm_flags, while mm_unmap and
+  mm_protect split a vma when they only cover part of it. mm->map_count always
+  equals the length of mm->mmap_list.
 ---------------
    check correctness functions
      void check_vmm(void);
@@ -34,8 +49,28 @@
      void check_pgfault(void);
 */
 
+// the number of page faults handled by do_pgfault
+volatile unsigned int pgfault_num = 0;
+
+struct fault_stats fault_stats;
+struct Page *zero_page;
+
+static DEFINE_LOCK_CLASS(mm_lock_class, "mm_lock");
+
+bool mm_reap_async = MM_REAP_ASYNC;
+struct reap_stats reap_stats;
+static struct workqueue *mm_reaper_wq;
+
 static void check_vmm(void);
 static void check_vma_struct(void);
+static void check_stack_growth(void);
+static void check_vma_merge_split(void);
+static void check_pt_share(void);
+static void check_fault_around(void);
+static void check_zero_page(void);
+static void check_ksm(void);
+static void check_mm_reap(void);
+static void check_mm_recycle(void);
 
 // mm_create -  alloc a mm_struct & initialize it.
 struct mm_struct *
@@ -53,7 +88,8 @@ mm_create(void)
         mm->sm_priv = NULL;
 
         set_mm_count(mm, 0);
-        lock_init(&(mm->mm_lock));
+        mutex_init(&(mm->mm_lock), &mm_lock_class);
+        mm->stack_limit = USTACKSIZE;
     }
     return mm;
 }
@@ -69,6 +105,7 @@ vma_create(uintptr_t vm_start, uintptr_t vm_end, uint32_t vm_flags)
         vma->vm_start = vm_start;
         vma->vm_end = vm_end;
         vma->vm_flags = vm_flags;
+        vma->vm_fault_around = FAULT_AROUND_DEFAULT;
     }
     return vma;
 }
@@ -116,8 +153,118 @@ check_vma_overlap(struct vma_struct *prev, struct vma_struct *next)
     assert(next->vm_start < next->vm_end);
 }
 
-// insert_vma_struct -insert vma in mm's list link
-void insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma)
+// vma_perm - the pte permission of the pages in vma
+static uint32_t
+vma_perm(struct vma_struct *vma)
+{
+    uint32_t perm = PTE_U;
+    if (vma->vm_flags & VM_READ)
+    {
+        perm |= PTE_R;
+    }
+    if (vma->vm_flags & VM_WRITE)
+    {
+        perm |= (PTE_R | PTE_W);
+    }
+    if (vma->vm_flags & VM_EXEC)
+    {
+        perm |= PTE_X;
+    }
+    return perm;
+}
+
+// find_stack_vma - find the VM_STACK vma which may grow down to cover addr
+//                - the stack may not exceed mm->stack_limit, and must keep at least
+//                - USTACKGUARDSIZE of unmapped space above the vma below it
+static struct vma_struct *
+find_stack_vma(struct mm_struct *mm, uintptr_t addr)
+{
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), prev_end = USERBASE;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        if (vma->vm_start > addr)
+        {
+            if (!(vma->vm_flags & VM_STACK) || !USER_ACCESS(start, vma->vm_end))
+            {
+                return NULL;
+            }
+            if (vma->vm_end - start > mm->stack_limit || start < prev_end + USTACKGUARDSIZE)
+            {
+                return NULL;
+            }
+            return vma;
+        }
+        prev_end = vma->vm_end;
+    }
+    return NULL;
+}
+
+// expand_stack - grow the stack vma down to the page which contains addr
+// return value: the grown vma, or NULL if addr is not a legal stack address
+struct vma_struct *
+expand_stack(struct mm_struct *mm, uintptr_t addr)
+{
+    struct vma_struct *vma = find_stack_vma(mm, addr);
+    if (vma != NULL)
+    {
+        vma->vm_start = ROUNDDOWN(addr, PGSIZE);
+    }
+    return vma;
+}
+
+// vma_merge_next - fold the vma following vma in mm's list into vma if they are
+//                - adjacent and have the same vm_flags
+// return value: 1 if merged
+static bool
+vma_merge_next(struct mm_struct *mm, struct vma_struct *vma)
+{
+    list_entry_t *le = list_next(&(vma->list_link));
+    if (le == &(mm->mmap_list))
+    {
+        return 0;
+    }
+    struct vma_struct *next = le2vma(le, list_link);
+    if (vma->vm_end != next->vm_start || vma->vm_flags != next->vm_flags ||
+        vma->vm_fault_around != next->vm_fault_around)
+    {
+        return 0;
+    }
+    vma->vm_end = next->vm_end;
+    list_del(le);
+    if (mm->mmap_cache == next)
+    {
+        mm->mmap_cache = vma;
+    }
+    kfree(next);
+    mm->map_count--;
+    return 1;
+}
+
+// vma_split - split vma into [vm_start, addr) and [addr, vm_end)
+// return value: the new vma which holds the upper part, NULL if out of memory
+static struct vma_struct *
+vma_split(struct mm_struct *mm, struct vma_struct *vma, uintptr_t addr)
+{
+    assert(vma->vm_start < addr && addr < vma->vm_end);
+    struct vma_struct *nvma = vma_create(addr, vma->vm_end, vma->vm_flags);
+    if (nvma != NULL)
+    {
+        nvma->vm_fault_around = vma->vm_fault_around;
+        nvma->vm_mm = mm;
+        vma->vm_end = addr;
+        list_add_after(&(vma->list_link), &(nvma->list_link));
+        mm->map_count++;
+    }
+    return nvma;
+}
+
+// insert_vma_struct -insert vma in mm's list link, merging it with its neighbours
+// return value: the vma which covers the inserted range afterwards. it is not vma
+//               itself if vma was merged into its predecessor, and vma is freed then.
+struct vma_struct *
+insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma)
 {
     assert(vma->vm_start < vma->vm_end);
     list_entry_t *list = &(mm->mmap_list);
@@ -150,6 +297,14 @@ void insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma)
     list_add_after(le_prev, &(vma->list_link));
 
     mm->map_count++;
+
+    /* merge with the neighbours */
+    vma_merge_next(mm, vma);
+    if (le_prev != list && vma_merge_next(mm, le2vma(le_prev, list_link)))
+    {
+        vma = le2vma(le_prev, list_link);
+    }
+    return vma;
 }
 
 // mm_destroy - free mm and mm internal fields
@@ -191,7 +346,7 @@ int mm_map(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags,
     {
         goto out;
     }
-    insert_vma_struct(mm, vma);
+    vma = insert_vma_struct(mm, vma);
     if (vma_store != NULL)
     {
         *vma_store = vma;
@@ -202,179 +357,1318 @@ out:
     return ret;
 }
 
-int dup_mmap(struct mm_struct *to, struct mm_struct *from)
+// vma_isolate - split the vmas around start and end so that no vma crosses them
+// return value: the first vma inside [start, end), or NULL if there is none.
+//               *err is set to -E_NO_MEM if a split fails
+static struct vma_struct *
+vma_isolate(struct mm_struct *mm, uintptr_t start, uintptr_t end, int *err)
 {
-    assert(to != NULL && from != NULL);
-    list_entry_t *list = &(from->mmap_list), *le = list;
-    while ((le = list_prev(le)) != list)
+    struct vma_struct *first = NULL;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    *err = 0;
+    while ((le = list_next(le)) != list)
     {
-        struct vma_struct *vma, *nvma;
-        vma = le2vma(le, list_link);
-        nvma = vma_create(vma->vm_start, vma->vm_end, vma->vm_flags);
-        if (nvma == NULL)
+        struct vma_struct *vma = le2vma(le, list_link);
+        if (vma->vm_end <= start)
         {
-            return -E_NO_MEM;
+            continue;
         }
-
-        insert_vma_struct(to, nvma);
-
-        bool share = 1;
-        if (copy_range(to->pgdir, from->pgdir, vma->vm_start, vma->vm_end, share) != 0)
+        if (vma->vm_start >= end)
         {
-            return -E_NO_MEM;
+            break;
+        }
+        if (vma->vm_start < start)
+        {
+            if ((vma = vma_split(mm, vma, start)) == NULL)
+            {
+                goto failed;
+            }
+            le = &(vma->list_link);
+        }
+        if (vma->vm_end > end && vma_split(mm, vma, end) == NULL)
+        {
+            goto failed;
+        }
+        if (first == NULL)
+        {
+            first = vma;
         }
     }
-    return 0;
+    return first;
+failed:
+    *err = -E_NO_MEM;
+    return NULL;
 }
 
-void exit_mmap(struct mm_struct *mm)
+// vma_merge_range - merge the vmas around [start, end) after their vm_flags changed
+static void
+vma_merge_range(struct mm_struct *mm, uintptr_t start, uintptr_t end)
 {
-    assert(mm != NULL && mm_count(mm) == 0);
-    pde_t *pgdir = mm->pgdir;
     list_entry_t *list = &(mm->mmap_list), *le = list;
     while ((le = list_next(le)) != list)
     {
         struct vma_struct *vma = le2vma(le, list_link);
-        unmap_range(pgdir, vma->vm_start, vma->vm_end);
-    }
-    while ((le = list_next(le)) != list)
-    {
-        struct vma_struct *vma = le2vma(le, list_link);
-        exit_range(pgdir, vma->vm_start, vma->vm_end);
+        if (vma->vm_start > end)
+        {
+            break;
+        }
+        if (vma->vm_end >= start)
+        {
+            while (vma_merge_next(mm, vma))
+                /* nothing */;
+        }
     }
 }
 
-bool copy_from_user(struct mm_struct *mm, void *dst, const void *src, size_t len, bool writable)
+// mm_unmap - remove the mapping of [addr, addr + len), partly covered vmas are split
+int mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len)
 {
-    if (!user_mem_check(mm, (uintptr_t)src, len, writable))
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    if (!USER_ACCESS(start, end))
     {
-        return 0;
+        return -E_INVAL;
     }
-    memcpy(dst, src, len);
-    return 1;
-}
 
-bool copy_to_user(struct mm_struct *mm, void *dst, const void *src, size_t len)
-{
-    if (!user_mem_check(mm, (uintptr_t)dst, len, 1))
+    assert(mm != NULL);
+
+    int ret;
+    struct vma_struct *vma = vma_isolate(mm, start, end, &ret);
+    if (ret != 0)
     {
-        return 0;
+        return ret;
     }
-    memcpy(dst, src, len);
-    return 1;
-}
-
-// vmm_init - initialize virtual memory management
-//          - now just call check_vmm to check correctness of vmm
-void vmm_init(void)
-{
-    check_vmm();
+    while (vma != NULL && vma->vm_start < end)
+    {
+        if (mm->pgdir != NULL)
+        {
+            if ((ret = unmap_range(mm->pgdir, vma->vm_start, vma->vm_end)) != 0)
+            {
+                return ret;
+            }
+            exit_range(mm->pgdir, vma->vm_start, vma->vm_end);
+        }
+        list_entry_t *le = list_next(&(vma->list_link));
+        list_del(&(vma->list_link));
+        mm->map_count--;
+        if (mm->mmap_cache == vma)
+        {
+            mm->mmap_cache = NULL;
+        }
+        kfree(vma);
+        vma = (le == &(mm->mmap_list)) ? NULL : le2vma(le, list_link);
+    }
+    return 0;
 }
 
-// check_vmm - check correctness of vmm
-static void
-check_vmm(void)
+// vma_range_mapped - whether every page in [start, end) belongs to a vma
+static bool
+vma_range_mapped(struct mm_struct *mm, uintptr_t start, uintptr_t end)
 {
-    // size_t nr_free_pages_store = nr_free_pages();
-
-    check_vma_struct();
-    // check_pgfault();
-
-    cprintf("check_vmm() succeeded.\n");
+    struct vma_struct *vma;
+    while (start < end)
+    {
+        if ((vma = find_vma(mm, start)) == NULL)
+        {
+            return 0;
+        }
+        start = vma->vm_end;
+    }
+    return 1;
 }
 
-static void
-check_vma_struct(void)
+// mm_protect - change the VM_PROT part of vm_flags of [addr, addr + len) to vm_flags
+//            - the whole range must be mapped. present ptes follow the new permission,
+//            - except that PTE_COW pages stay read-only until their next write fault
+int mm_protect(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags)
 {
-    // size_t nr_free_pages_store = nr_free_pages();
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    if (!USER_ACCESS(start, end))
+    {
+        return -E_INVAL;
+    }
 
-    struct mm_struct *mm = mm_create();
     assert(mm != NULL);
 
-    int step1 = 10, step2 = step1 * 10;
+    if (!vma_range_mapped(mm, start, end))
+    {
+        return -E_INVAL;
+    }
 
-    int i;
-    for (i = step1; i >= 1; i--)
+    int ret;
+    uintptr_t la;
+    struct vma_struct *vma;
+    if ((vma = vma_isolate(mm, start, end, &ret)) == NULL)
     {
-        struct vma_struct *vma = vma_create(i * 5, i * 5 + 2, 0);
-        assert(vma != NULL);
-        insert_vma_struct(mm, vma);
+        return ret;
+    }
+    for (; vma->vm_start < end; vma = le2vma(list_next(&(vma->list_link)), list_link))
+    {
+        vma->vm_flags = (vma->vm_flags & ~VM_PROT) | (vm_flags & VM_PROT);
+        uint32_t perm = vma_perm(vma);
+        for (la = vma->vm_start; mm->pgdir != NULL && la < vma->vm_end; la += PGSIZE)
+        {
+            pte_t *ptep = get_pte(mm->pgdir, la, 0);
+            if (ptep == NULL)
+            {
+                la = ROUNDDOWN(la + PTSIZE, PTSIZE) - PGSIZE;
+                continue;
+            }
+            if ((*ptep & PTE_V) && (ptep = get_pte(mm->pgdir, la, 1)) == NULL)
+            {
+                // the PT is shared with another address space and can't be copied
+                return -E_NO_MEM;
+            }
+            if (*ptep & PTE_V)
+            {
+                uint32_t nperm = (*ptep & PTE_COW) ? (perm & ~PTE_W) : perm;
+                *ptep = (*ptep & ~PTE_USER) | PTE_V | nperm;
+            }
+        }
+        if (list_next(&(vma->list_link)) == &(mm->mmap_list))
+        {
+            break;
+        }
     }
+    flush_tlb();
+    vma_merge_range(mm, start, end);
+    return 0;
+}
 
-    for (i = step1 + 1; i <= step2; i++)
+// mm_fault_around - set vm_fault_around of [addr, addr + len) to pages
+//                 - the whole range must be mapped, pages is a power of 2
+//                 - no bigger than FAULT_AROUND_MAX, 1 turns fault-around off
+int mm_fault_around(struct mm_struct *mm, uintptr_t addr, size_t len, size_t pages)
+{
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    if (!USER_ACCESS(start, end) || pages == 0 || pages > FAULT_AROUND_MAX || (pages & (pages - 1)) != 0)
     {
-        struct vma_struct *vma = vma_create(i * 5, i * 5 + 2, 0);
-        assert(vma != NULL);
-        insert_vma_struct(mm, vma);
+        return -E_INVAL;
     }
 
-    list_entry_t *le = list_next(&(mm->mmap_list));
+    assert(mm != NULL);
 
-    for (i = 1; i <= step2; i++)
+    if (!vma_range_mapped(mm, start, end))
     {
-        assert(le != &(mm->mmap_list));
-        struct vma_struct *mmap = le2vma(le, list_link);
-        assert(mmap->vm_start == i * 5 && mmap->vm_end == i * 5 + 2);
-        le = list_next(le);
+        return -E_INVAL;
     }
 
-    for (i = 5; i <= 5 * step2; i += 5)
+    int ret;
+    struct vma_struct *vma;
+    if ((vma = vma_isolate(mm, start, end, &ret)) == NULL)
     {
-        struct vma_struct *vma1 = find_vma(mm, i);
-        assert(vma1 != NULL);
-        struct vma_struct *vma2 = find_vma(mm, i + 1);
-        assert(vma2 != NULL);
-        struct vma_struct *vma3 = find_vma(mm, i + 2);
-        assert(vma3 == NULL);
-        struct vma_struct *vma4 = find_vma(mm, i + 3);
-        assert(vma4 == NULL);
-        struct vma_struct *vma5 = find_vma(mm, i + 4);
-        assert(vma5 == NULL);
-
-        assert(vma1->vm_start == i && vma1->vm_end == i + 2);
-        assert(vma2->vm_start == i && vma2->vm_end == i + 2);
+        return ret;
     }
-
-    for (i = 4; i >= 0; i--)
+    while (1)
     {
-        struct vma_struct *vma_below_5 = find_vma(mm, i);
-        if (vma_below_5 != NULL)
+        vma->vm_fault_around = pages;
+        list_entry_t *le = list_next(&(vma->list_link));
+        if (le == &(mm->mmap_list) || (vma = le2vma(le, list_link))->vm_start >= end)
         {
-            cprintf("vma_below_5: i %x, start %x, end %x\n", i, vma_below_5->vm_start, vma_below_5->vm_end);
+            break;
         }
-        assert(vma_below_5 == NULL);
     }
+    vma_merge_range(mm, start, end);
+    return 0;
+}
 
-    mm_destroy(mm);
+// mm_brk - map [addr, addr + len) as read/write heap memory, growing the vma below
+int mm_brk(struct mm_struct *mm, uintptr_t addr, size_t len)
+{
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    if (!USER_ACCESS(start, end))
+    {
+        return -E_INVAL;
+    }
 
-    cprintf("check_vma_struct() succeeded!\n");
+    int ret;
+    if ((ret = mm_unmap(mm, start, end - start)) != 0)
+    {
+        return ret;
+    }
+    return mm_map(mm, start, end - start, VM_READ | VM_WRITE, NULL);
 }
-bool user_mem_check(struct mm_struct *mm, uintptr_t addr, size_t len, bool write)
+
+// get_unmapped_area - find a free range of len bytes for a new mapping, below the
+//                   - region the user stack may grow into
+// return value: the start of the range, or 0 if there is none
+uintptr_t get_unmapped_area(struct mm_struct *mm, size_t len)
 {
-    if (mm != NULL)
+    uintptr_t top = USTACKTOP - mm->stack_limit - USTACKGUARDSIZE;
+    if (len == 0 || len > top - USERBASE)
     {
-        if (!USER_ACCESS(addr, addr + len))
+        return 0;
+    }
+    uintptr_t start = top - len;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_prev(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        if (start >= vma->vm_end)
         {
-            return 0;
+            break;
         }
-        struct vma_struct *vma;
-        uintptr_t start = addr, end = addr + len;
-        while (start < end)
+        if (start + len > vma->vm_start)
         {
-            if ((vma = find_vma(mm, start)) == NULL || start < vma->vm_start)
+            if (vma->vm_start < USERBASE + len)
             {
                 return 0;
             }
-            if (!(vma->vm_flags & ((write) ? VM_WRITE : VM_READ)))
+            start = vma->vm_start - len;
+        }
+    }
+    return start;
+}
+
+// mm_populate - allocate zeroed pages for every unmapped page in [start, end),
+//             - which must be covered by vmas
+int mm_populate(struct mm_struct *mm, uintptr_t start, uintptr_t end)
+{
+    assert(start % PGSIZE == 0 && end % PGSIZE == 0);
+    uintptr_t la;
+    for (la = start; la < end; la += PGSIZE)
+    {
+        struct vma_struct *vma = find_vma(mm, la);
+        assert(vma != NULL);
+        pte_t *ptep = get_pte(mm->pgdir, la, 1);
+        if (ptep == NULL)
+        {
+            return -E_NO_MEM;
+        }
+        if (*ptep == 0)
+        {
+            struct Page *page;
+            if ((page = pgdir_alloc_page(mm->pgdir, la, vma_perm(vma))) == NULL)
             {
-                return 0;
+                return -E_NO_MEM;
             }
-            if (write && (vma->vm_flags & VM_STACK))
-            {
-                if (start < vma->vm_start + PGSIZE)
-                { // check stack start & size
-                    return 0;
-                }
+            memset(page2kva(page), 0, PGSIZE);
+        }
+    }
+    return 0;
+}
+
+// pt_has_shared_vma - whether a VM_SHARED vma of mm overlaps the PTSIZE chunk containing la
+static bool
+pt_has_shared_vma(struct mm_struct *mm, uintptr_t la)
+{
+    uintptr_t start = ROUNDDOWN(la, PTSIZE), end = start + PTSIZE;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        if (vma->vm_start >= end)
+        {
+            break;
+        }
+        if (vma->vm_end > start && (vma->vm_flags & VM_SHARED))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int dup_mmap(struct mm_struct *to, struct mm_struct *from)
+{
+    assert(to != NULL && from != NULL);
+    to->stack_limit = from->stack_limit;
+    list_entry_t *list = &(from->mmap_list), *le = list;
+    while ((le = list_prev(le)) != list)
+    {
+        struct vma_struct *vma, *nvma;
+        vma = le2vma(le, list_link);
+        nvma = vma_create(vma->vm_start, vma->vm_end, vma->vm_flags);
+        if (nvma == NULL)
+        {
+            return -E_NO_MEM;
+        }
+        nvma->vm_fault_around = vma->vm_fault_around;
+
+        insert_vma_struct(to, nvma);
+
+        // share whole PTs with from, unless VM_SHARED pages make the ptes differ
+        bool share = (vma->vm_flags & VM_SHARED) != 0;
+        uintptr_t start = vma->vm_start, end;
+        for (; start < vma->vm_end; start = end)
+        {
+            end = ROUNDDOWN(start + PTSIZE, PTSIZE);
+            end = (end < vma->vm_end) ? end : vma->vm_end;
+            int ret;
+            if (share || pt_has_shared_vma(from, start))
+            {
+                ret = copy_range(to->pgdir, from->pgdir, start, end, share);
+            }
+            else
+            {
+                ret = share_pt(to->pgdir, from->pgdir, start);
+            }
+            if (ret != 0)
+            {
+                return -E_NO_MEM;
+            }
+        }
+    }
+    // ptes of from may have become read-only
+    flush_tlb();
+    return 0;
+}
+
+// __exit_mmap - free the memory and page tables of mm. with resched, give
+//             - the cpu away between PTSIZE chunks whenever it is asked for
+static void
+__exit_mmap(struct mm_struct *mm, bool resched)
+{
+    assert(mm != NULL && mm_count(mm) == 0);
+    pde_t *pgdir = mm->pgdir;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        detach_shared_pts(pgdir, vma->vm_start, vma->vm_end);
+    }
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        uintptr_t start = vma->vm_start, end;
+        for (; start < vma->vm_end; start = end)
+        {
+            end = ROUNDDOWN(start, PTSIZE) + PTSIZE;
+            end = (end < vma->vm_end) ? end : vma->vm_end;
+            // no PT is shared any more, so this never allocates
+            int ret = unmap_range(pgdir, start, end);
+            assert(ret == 0);
+            if (resched && current->need_resched)
+            {
+                reap_stats.yields++;
+                schedule();
+            }
+        }
+    }
+    // the whole user half, not only the vmas: PTs kept by mm_recycle may lie
+    // outside the vmas of the program loaded after it
+    exit_range(pgdir, USERBASE, USERTOP);
+}
+
+void exit_mmap(struct mm_struct *mm)
+{
+    __exit_mmap(mm, 0);
+}
+
+// mm_reap - free all of mm right now: its memory, page tables, PDT, vmas
+//         - and itself. with resched, give the cpu away while at it if asked
+void mm_reap(struct mm_struct *mm, bool resched)
+{
+    __exit_mmap(mm, resched);
+    free_page(kva2page(mm->pgdir));
+    mm_destroy(mm);
+}
+
+// mm_recycle - empty mm, used by nobody but current, for the next program it
+//            - execs: the pages and vmas go, while the PDT with the kernel half
+//            - and the private PTs stay, so loading the program reuses them. the
+//            - ones it does not reuse are freed with the rest by __exit_mmap
+void mm_recycle(struct mm_struct *mm)
+{
+    assert(mm != NULL && mm_count(mm) == 1);
+    pde_t *pgdir = mm->pgdir;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        detach_shared_pts(pgdir, vma->vm_start, vma->vm_end);
+    }
+    while ((le = list_next(list)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        // no PT is shared any more, so this never allocates
+        int ret = unmap_range(pgdir, vma->vm_start, vma->vm_end);
+        assert(ret == 0);
+        list_del(le);
+        kfree(vma);
+    }
+    mm->mmap_cache = NULL;
+    mm->map_count = 0;
+    mm->stack_limit = USTACKSIZE;
+    flush_tlb();
+}
+
+// mm_reap_work - the work of mm_reaper_wq freeing one mm
+static void
+mm_reap_work(struct work_struct *work)
+{
+    // flush_workqueue may run it at boot, with nothing to schedule yet
+    mm_reap(to_struct(work, struct mm_struct, reap_work), current != NULL);
+    reap_stats.reaped++;
+}
+
+// exit_mm - free mm, the last process using it is gone. with mm_reap_async
+//         - the frames go back in the background on mm_reaper_wq, a PTSIZE
+//         - chunk at a time, so neither the exiting process nor its parent
+//         - waits for them
+void exit_mm(struct mm_struct *mm)
+{
+    assert(mm_count(mm) == 0);
+    if (mm_reap_async && mm_reaper_wq != NULL)
+    {
+        INIT_WORK(&(mm->reap_work), mm_reap_work);
+        queue_work(mm_reaper_wq, &(mm->reap_work));
+        reap_stats.queued++;
+        return;
+    }
+    mm_reap(mm, 0);
+    reap_stats.sync++;
+}
+
+void print_reap_stats(void)
+{
+    cprintf("reap: %s, %llu mms queued, %llu reaped, %llu pending, %llu synchronous\n",
+            mm_reap_async ? "async" : "sync", reap_stats.queued, reap_stats.reaped,
+            reap_stats.queued - reap_stats.reaped, reap_stats.sync);
+    cprintf("reap: %llu yields while freeing\n", reap_stats.yields);
+}
+
+// mm_reap_init - create mm_reaper_wq, its worker starts with the others
+void mm_reap_init(void)
+{
+    if ((mm_reaper_wq = create_workqueue("mm_reaper", 1)) == NULL)
+    {
+        panic("cannot create mm_reaper_wq.\n");
+    }
+    check_mm_reap();
+}
+
+// copy_from_user - copy len bytes from user addr src in mm to kernel addr dst
+//                - only the range is checked here, an unmapped or read-protected
+//                - page makes __copy_user stop at its fixup (see uaccess.h)
+// @writable:     src must also be writable by the user
+bool copy_from_user(struct mm_struct *mm, void *dst, const void *src, size_t len, bool writable)
+{
+    if (mm == NULL)
+    {
+        if (!KERN_ACCESS((uintptr_t)src, (uintptr_t)src + len))
+        {
+            return 0;
+        }
+        memcpy(dst, src, len);
+        return 1;
+    }
+    if (!USER_ACCESS((uintptr_t)src, (uintptr_t)src + len))
+    {
+        return 0;
+    }
+    if (writable && !user_mem_check(mm, (uintptr_t)src, len, 1))
+    {
+        return 0;
+    }
+    return __copy_user(dst, src, len) == 0;
+}
+
+// copy_to_user - copy len bytes from kernel addr src to user addr dst in mm
+bool copy_to_user(struct mm_struct *mm, void *dst, const void *src, size_t len)
+{
+    if (mm == NULL)
+    {
+        if (!KERN_ACCESS((uintptr_t)dst, (uintptr_t)dst + len))
+        {
+            return 0;
+        }
+        memcpy(dst, src, len);
+        return 1;
+    }
+    if (!USER_ACCESS((uintptr_t)dst, (uintptr_t)dst + len))
+    {
+        return 0;
+    }
+    return __copy_user(dst, src, len) == 0;
+}
+
+// vmm_init - initialize virtual memory management
+//          - now just call check_vmm to check correctness of vmm
+void vmm_init(void)
+{
+    if ((zero_page = alloc_page()) == NULL)
+    {
+        panic("vmm_init: no memory for the zero page.\n");
+    }
+    memset(page2kva(zero_page), 0, PGSIZE);
+    set_page_ref(zero_page, 1);
+    ksm_init();
+
+    check_vmm();
+}
+
+// check_vmm - check correctness of vmm
+static void
+check_vmm(void)
+{
+    // size_t nr_free_pages_store = nr_free_pages();
+
+    check_vma_struct();
+    check_stack_growth();
+    check_vma_merge_split();
+    check_pt_share();
+    check_fault_around();
+    check_zero_page();
+    check_ksm();
+    check_mm_recycle();
+    // check_pgfault();
+
+    cprintf("check_vmm() succeeded.\n");
+}
+
+static void
+check_vma_struct(void)
+{
+    // size_t nr_free_pages_store = nr_free_pages();
+
+    struct mm_struct *mm = mm_create();
+    assert(mm != NULL);
+
+    int step1 = 10, step2 = step1 * 10;
+
+    int i;
+    for (i = step1; i >= 1; i--)
+    {
+        struct vma_struct *vma = vma_create(i * 5, i * 5 + 2, 0);
+        assert(vma != NULL);
+        insert_vma_struct(mm, vma);
+    }
+
+    for (i = step1 + 1; i <= step2; i++)
+    {
+        struct vma_struct *vma = vma_create(i * 5, i * 5 + 2, 0);
+        assert(vma != NULL);
+        insert_vma_struct(mm, vma);
+    }
+
+    list_entry_t *le = list_next(&(mm->mmap_list));
+
+    for (i = 1; i <= step2; i++)
+    {
+        assert(le != &(mm->mmap_list));
+        struct vma_struct *mmap = le2vma(le, list_link);
+        assert(mmap->vm_start == i * 5 && mmap->vm_end == i * 5 + 2);
+        le = list_next(le);
+    }
+
+    for (i = 5; i <= 5 * step2; i += 5)
+    {
+        struct vma_struct *vma1 = find_vma(mm, i);
+        assert(vma1 != NULL);
+        struct vma_struct *vma2 = find_vma(mm, i + 1);
+        assert(vma2 != NULL);
+        struct vma_struct *vma3 = find_vma(mm, i + 2);
+        assert(vma3 == NULL);
+        struct vma_struct *vma4 = find_vma(mm, i + 3);
+        assert(vma4 == NULL);
+        struct vma_struct *vma5 = find_vma(mm, i + 4);
+        assert(vma5 == NULL);
+
+        assert(vma1->vm_start == i && vma1->vm_end == i + 2);
+        assert(vma2->vm_start == i && vma2->vm_end == i + 2);
+    }
+
+    for (i = 4; i >= 0; i--)
+    {
+        struct vma_struct *vma_below_5 = find_vma(mm, i);
+        if (vma_below_5 != NULL)
+        {
+            cprintf("vma_below_5: i %x, start %x, end %x\n", i, vma_below_5->vm_start, vma_below_5->vm_end);
+        }
+        assert(vma_below_5 == NULL);
+    }
+
+    mm_destroy(mm);
+
+    cprintf("check_vma_struct() succeeded!\n");
+}
+
+static void
+check_stack_growth(void)
+{
+    struct mm_struct *mm = mm_create();
+    assert(mm != NULL);
+
+    uintptr_t heap_end = USTACKTOP - 2 * USTACKSIZE;
+    assert(mm_map(mm, UTEXT, heap_end - UTEXT, VM_READ | VM_WRITE, NULL) == 0);
+
+    struct vma_struct *stack;
+    assert(mm_map(mm, USTACKTOP - PGSIZE, PGSIZE, VM_READ | VM_WRITE | VM_STACK, &stack) == 0);
+
+    // grow by a few pages below the top page
+    assert(expand_stack(mm, USTACKTOP - 3 * PGSIZE + 8) == stack);
+    assert(stack->vm_start == USTACKTOP - 3 * PGSIZE);
+    assert(find_vma(mm, USTACKTOP - 3 * PGSIZE) == stack);
+    assert(user_mem_check(mm, USTACKTOP - 8 * PGSIZE, PGSIZE, 1));
+
+    // never beyond the per-process stack limit
+    assert(expand_stack(mm, USTACKTOP - USTACKSIZE - PGSIZE) == NULL);
+    assert(expand_stack(mm, USTACKTOP - USTACKSIZE) == stack);
+
+    // never into the guard region above the vma below the stack
+    mm->stack_limit = 2 * USTACKSIZE;
+    assert(expand_stack(mm, heap_end + USTACKGUARDSIZE - PGSIZE) == NULL);
+    assert(!user_mem_check(mm, heap_end, PGSIZE, 1));
+    assert(expand_stack(mm, heap_end + USTACKGUARDSIZE) == stack);
+
+    // only addresses below a stack vma may grow it
+    assert(expand_stack(mm, UTEXT - PGSIZE) == NULL);
+
+    mm_destroy(mm);
+
+    cprintf("check_stack_growth() succeeded!\n");
+}
+
+// check_pt_mm - an mm with a bare user-only page directory, enough for dup_mmap and do_pgfault
+static struct mm_struct *
+check_pt_mm(void)
+{
+    struct mm_struct *mm = mm_create();
+    struct Page *page = alloc_page();
+    assert(mm != NULL && page != NULL);
+    mm->pgdir = page2kva(page);
+    memset(mm->pgdir, 0, PGSIZE);
+    return mm;
+}
+
+static void
+check_pt_mm_destroy(struct mm_struct *mm)
+{
+    exit_mmap(mm);
+    free_page(kva2page(mm->pgdir));
+    mm_destroy(mm);
+}
+
+static void
+check_pt_share(void)
+{
+    struct mm_struct *from = check_pt_mm(), *to = check_pt_mm();
+    uintptr_t base = UTEXT;
+
+    assert(mm_map(from, base, 4 * PGSIZE, VM_READ | VM_WRITE, NULL) == 0);
+    assert(mm_populate(from, base, base + 4 * PGSIZE) == 0);
+    struct Page *page = get_page(from->pgdir, base, NULL);
+    *(int *)page2kva(page) = 0x55;
+
+    // fork shares the PT, write-protecting its ptes, and takes no page references
+    assert(dup_mmap(to, from) == 0);
+    pte_t *ptep = get_pte(from->pgdir, base, 0);
+    struct Page *pt = kva2page((void *)ROUNDDOWN((uintptr_t)ptep, PGSIZE));
+    assert(get_pte(to->pgdir, base, 0) == ptep && page_ref(pt) == 2);
+    assert(!(*ptep & PTE_W) && (*ptep & PTE_COW) && page_ref(page) == 1);
+
+    // a write fault gives the faulting side its own PT, then copies the page
+    assert(do_pgfault(to, CAUSE_STORE_PAGE_FAULT, base) == 0);
+    pte_t *tptep = get_pte(to->pgdir, base, 0);
+    assert(tptep != ptep && (*tptep & PTE_W) && pte2page(*tptep) != page);
+    assert(*(int *)page2kva(pte2page(*tptep)) == 0x55);
+    assert(page_ref(pt) == 1 && page_ref(page) == 1 && page_ref(pte2page(ptep[1])) == 2);
+
+    check_pt_mm_destroy(to);
+    assert(page_ref(pte2page(ptep[1])) == 1);
+
+    // unmapping part of a shared PT leaves the other side's view alone
+    to = check_pt_mm();
+    assert(dup_mmap(to, from) == 0 && page_ref(pt) == 2);
+    struct Page *page1 = pte2page(ptep[1]);
+    assert(mm_unmap(from, base + PGSIZE, PGSIZE) == 0);
+    assert(page_ref(pt) == 1 && page_ref(page1) == 1);
+    assert(get_page(to->pgdir, base + PGSIZE, NULL) == page1);
+    assert(get_page(from->pgdir, base + PGSIZE, NULL) == NULL);
+
+    // and exit of a sharer just drops the PT
+    check_pt_mm_destroy(from);
+    assert(page_ref(pt) == 1 && page_ref(page) == 1 && get_page(to->pgdir, base, NULL) == page);
+    check_pt_mm_destroy(to);
+
+    cprintf("check_pt_share() succeeded!\n");
+}
+
+static void
+check_fault_around(void)
+{
+    struct mm_struct *from = check_pt_mm(), *to = check_pt_mm();
+    uintptr_t base = UTEXT;
+    int i;
+
+    assert(mm_map(from, base, 8 * PGSIZE, VM_READ | VM_WRITE, NULL) == 0);
+    assert(mm_populate(from, base, base + 8 * PGSIZE) == 0);
+    assert(mm_fault_around(from, base, 8 * PGSIZE, 3) != 0);
+    assert(mm_fault_around(from, base, 8 * PGSIZE, 4) == 0);
+    assert(dup_mmap(to, from) == 0);
+
+    // a COW fault breaks COW on its whole aligned window and no further
+    struct fault_stats old = fault_stats;
+    assert(do_pgfault(to, CAUSE_STORE_PAGE_FAULT, base + 5 * PGSIZE) == 0);
+    for (i = 0; i < 8; i++)
+    {
+        pte_t pte = *get_pte(to->pgdir, base + i * PGSIZE, 0);
+        struct Page *page = get_page(from->pgdir, base + i * PGSIZE, NULL);
+        if (i >= 4)
+        {
+            assert((pte & PTE_W) && !(pte & PTE_COW) && pte2page(pte) != page && page_ref(page) == 1);
+        }
+        else
+        {
+            assert(!(pte & PTE_W) && (pte & PTE_COW) && pte2page(pte) == page && page_ref(page) == 2);
+        }
+    }
+    assert(fault_stats.faults == old.faults + 1 && fault_stats.around_cow == old.around_cow + 3);
+
+    // an absent page fault fills its window the same way, clipped to the vma
+    struct vma_struct *vma;
+    uintptr_t base2 = base + PTSIZE;
+    assert(mm_map(from, base2, 6 * PGSIZE, VM_READ | VM_WRITE, &vma) == 0);
+    vma->vm_fault_around = 8;
+    old = fault_stats;
+    assert(do_pgfault(from, CAUSE_STORE_PAGE_FAULT, base2 + PGSIZE) == 0);
+    for (i = 0; i < 6; i++)
+    {
+        struct Page *page = get_page(from->pgdir, base2 + i * PGSIZE, NULL);
+        assert(page != NULL && page != zero_page && page_ref(page) == 1 && *(int *)page2kva(page) == 0);
+    }
+    assert(fault_stats.around_mapped == old.around_mapped + 5);
+
+    // fault-around off resolves just the faulting page
+    uintptr_t base3 = base2 + 16 * PGSIZE;
+    assert(mm_map(from, base3, 4 * PGSIZE, VM_READ, NULL) == 0);
+    assert(mm_fault_around(from, base3, 4 * PGSIZE, 1) == 0);
+    assert(do_pgfault(from, CAUSE_LOAD_PAGE_FAULT, base3) == 0);
+    assert(get_page(from->pgdir, base3, NULL) != NULL && get_page(from->pgdir, base3 + PGSIZE, NULL) == NULL);
+
+    check_pt_mm_destroy(to);
+    check_pt_mm_destroy(from);
+
+    cprintf("check_fault_around() succeeded!\n");
+}
+
+static void
+check_zero_page(void)
+{
+    struct mm_struct *mm = check_pt_mm();
+    uintptr_t base = UTEXT;
+    int zero_ref = page_ref(zero_page);
+
+    // reads of untouched memory all map the zero page, read-only
+    assert(mm_map(mm, base, 4 * PGSIZE, VM_READ | VM_WRITE, NULL) == 0);
+    assert(mm_fault_around(mm, base, 4 * PGSIZE, 1) == 0);
+    assert(do_pgfault(mm, CAUSE_LOAD_PAGE_FAULT, base) == 0);
+    assert(do_pgfault(mm, CAUSE_LOAD_PAGE_FAULT, base + PGSIZE) == 0);
+    pte_t *ptep = get_pte(mm->pgdir, base, 0);
+    assert(pte2page(*ptep) == zero_page && pte2page(ptep[1]) == zero_page);
+    assert(!(*ptep & PTE_W) && (*ptep & PTE_COW) && page_ref(zero_page) == zero_ref + 2);
+
+    // a write gets a private zeroed copy
+    assert(do_pgfault(mm, CAUSE_STORE_PAGE_FAULT, base) == 0);
+    struct Page *page = pte2page(*ptep);
+    assert(page != zero_page && (*ptep & PTE_W) && *(int *)page2kva(page) == 0);
+    assert(page_ref(zero_page) == zero_ref + 1);
+
+    // a read-only vma made writable still copies on write
+    assert(mm_map(mm, base + 8 * PGSIZE, PGSIZE, VM_READ, NULL) == 0);
+    assert(do_pgfault(mm, CAUSE_LOAD_PAGE_FAULT, base + 8 * PGSIZE) == 0);
+    assert(mm_protect(mm, base + 8 * PGSIZE, PGSIZE, VM_READ | VM_WRITE) == 0);
+    assert(!(ptep[8] & PTE_W) && pte2page(ptep[8]) == zero_page);
+    assert(do_pgfault(mm, CAUSE_STORE_PAGE_FAULT, base + 8 * PGSIZE) == 0);
+    assert(pte2page(ptep[8]) != zero_page && *(int *)page2kva(zero_page) == 0);
+
+    check_pt_mm_destroy(mm);
+    assert(page_ref(zero_page) == zero_ref);
+
+    cprintf("check_zero_page() succeeded!\n");
+}
+
+static void
+check_ksm(void)
+{
+    struct mm_struct *mm[2] = {check_pt_mm(), check_pt_mm()};
+    uintptr_t base = UTEXT, addr;
+    struct ksm_stats old = ksm_stats;
+    size_t budget;
+    int i, j;
+
+    // two workers with equal pages 0 and 1, a page 2 of their own and a zeroed page 3
+    for (i = 0; i < 2; i++)
+    {
+        assert(mm_map(mm[i], base, 4 * PGSIZE, VM_READ | VM_WRITE, NULL) == 0);
+        assert(mm_populate(mm[i], base, base + 4 * PGSIZE) == 0);
+        for (j = 0; j < 3; j++)
+        {
+            memset(page2kva(get_page(mm[i]->pgdir, base + j * PGSIZE, NULL)), (j < 2) ? 0x10 + j : 0x20 + i, PGSIZE);
+        }
+    }
+
+    // the first pass finds pages 0 and 1 of mm[1] seen before and makes them stable,
+    // the second one merges those of mm[0]. zeroed pages go to the zero page right away
+    ksm_pass_end();
+    for (j = 0; j < 2; j++)
+    {
+        budget = 8;
+        for (i = 0; i < 2; i++)
+        {
+            addr = 0;
+            assert(ksm_scan_mm(mm[i], &addr, &budget));
+        }
+        ksm_pass_end();
+    }
+    for (j = 0; j < 2; j++)
+    {
+        pte_t *ptep = get_pte(mm[0]->pgdir, base + j * PGSIZE, 0);
+        struct Page *frame = pte2page(*ptep);
+        assert(get_page(mm[1]->pgdir, base + j * PGSIZE, NULL) == frame && page_ref(frame) == 3);
+        assert(!(*ptep & PTE_W) && (*ptep & PTE_COW) && *(char *)page2kva(frame) == 0x10 + j);
+    }
+    assert(get_page(mm[0]->pgdir, base + 2 * PGSIZE, NULL) != get_page(mm[1]->pgdir, base + 2 * PGSIZE, NULL));
+    assert(get_page(mm[0]->pgdir, base + 3 * PGSIZE, NULL) == zero_page);
+    assert(ksm_stats.promoted == old.promoted + 2 && ksm_stats.merged == old.merged + 2);
+    assert(ksm_stats.zeroed == old.zeroed + 2);
+
+    // a write breaks COW as usual, and the stable frame stays as it is
+    struct Page *frame = get_page(mm[0]->pgdir, base, NULL);
+    assert(mm_fault_around(mm[0], base, 4 * PGSIZE, 1) == 0);
+    assert(do_pgfault(mm[0], CAUSE_STORE_PAGE_FAULT, base) == 0);
+    struct Page *page = get_page(mm[0]->pgdir, base, NULL);
+    assert(page != frame && page_ref(frame) == 2 && *(char *)page2kva(page) == 0x10);
+
+    // stable frames nobody maps are freed at the end of the next pass
+    check_pt_mm_destroy(mm[0]);
+    check_pt_mm_destroy(mm[1]);
+    size_t nr_free_pages_store = nr_free_pages();
+    ksm_pass_end();
+    assert(nr_free_pages() == nr_free_pages_store + 2 && ksm_stats.pruned == old.pruned + 2);
+
+    cprintf("check_ksm() succeeded!\n");
+}
+
+// check_mm_reap - run before the workers start, so flush_workqueue reaps
+static void
+check_mm_reap(void)
+{
+    bool async_store = mm_reap_async;
+    struct reap_stats old = reap_stats;
+    uintptr_t base = UTEXT;
+    int i;
+
+    // the frames of a queued mm come back only when the reaper runs
+    mm_reap_async = 1;
+    for (i = 0; i < 2; i++)
+    {
+        struct mm_struct *mm = check_pt_mm();
+        assert(mm_map(mm, base, 8 * PGSIZE, VM_READ | VM_WRITE, NULL) == 0);
+        assert(mm_populate(mm, base, base + 8 * PGSIZE) == 0);
+        size_t nr_free_pages_store = nr_free_pages();
+        exit_mm(mm);
+        if (i == 0)
+        {
+            assert(nr_free_pages() == nr_free_pages_store && mm_reaper_wq->depth == 1);
+            assert(reap_stats.queued == old.queued + 1 && reap_stats.reaped == old.reaped);
+            flush_workqueue(mm_reaper_wq);
+            assert(reap_stats.reaped == old.reaped + 1);
+        }
+        // the pages, their PT and the PDT
+        assert(nr_free_pages() >= nr_free_pages_store + 8 + 2);
+        mm_reap_async = 0;
+    }
+    assert(reap_stats.sync == old.sync + 1 && mm_reaper_wq->depth == 0);
+
+    mm_reap_async = async_store;
+    cprintf("check_mm_reap() succeeded!\n");
+}
+
+// check_mm_recycle - exec into a smaller program, then exit, gives back every PT
+static void
+check_mm_recycle(void)
+{
+    struct mm_struct *mm = check_pt_mm();
+    uintptr_t base = UTEXT, top = USERTOP - PGSIZE;
+    int i;
+
+    // a page in each of 4 PTs, and one in another PD0 under USERTOP
+    assert(mm_map(mm, base, 4 * PTSIZE, VM_READ | VM_WRITE, NULL) == 0);
+    assert(mm_map(mm, top, PGSIZE, VM_READ | VM_WRITE, NULL) == 0);
+    size_t nr_free_pages_store = nr_free_pages();
+    for (i = 0; i < 4; i++)
+    {
+        assert(mm_populate(mm, base + i * PTSIZE, base + i * PTSIZE + PGSIZE) == 0);
+    }
+    assert(mm_populate(mm, top, top + PGSIZE) == 0);
+
+    // the new program only uses the first PT, the others are kept empty
+    mm_count_inc(mm);
+    mm_recycle(mm);
+    mm_count_dec(mm);
+    assert(mm->map_count == 0 && get_pte(mm->pgdir, base + PTSIZE, 0) != NULL);
+    assert(mm_map(mm, base, PGSIZE, VM_READ | VM_WRITE, NULL) == 0);
+    assert(mm_populate(mm, base, base + PGSIZE) == 0);
+
+    exit_mmap(mm);
+    assert(nr_free_pages() == nr_free_pages_store);
+    free_page(kva2page(mm->pgdir));
+    mm_destroy(mm);
+
+    cprintf("check_mm_recycle() succeeded!\n");
+}
+
+// print_mm - print the vma layout of mm
+void print_mm(struct mm_struct *mm)
+{
+    cprintf("mm %p: pgdir %p, map_count %d, mm_count %d\n", mm, mm->pgdir, mm->map_count, mm_count(mm));
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        cprintf("  [%08lx, %08lx) %6d pages %c%c%c fault-around %2d%s%s\n", vma->vm_start, vma->vm_end,
+                (int)((vma->vm_end - vma->vm_start) / PGSIZE),
+                (vma->vm_flags & VM_READ) ? 'r' : '-', (vma->vm_flags & VM_WRITE) ? 'w' : '-',
+                (vma->vm_flags & VM_EXEC) ? 'x' : '-', (int)vma->vm_fault_around,
+                (vma->vm_flags & VM_STACK) ? " stack" : "", (vma->vm_flags & VM_SHARED) ? " shared" : "");
+    }
+}
+
+// check_vma_layout - check that mm holds exactly the n vmas in ranges[] with flags[]
+static void
+check_vma_layout(struct mm_struct *mm, int n, uintptr_t ranges[][2], uint32_t flags[])
+{
+    int i = 0;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        struct vma_struct *vma = le2vma(le, list_link);
+        assert(i < n);
+        assert(vma->vm_start == ranges[i][0] && vma->vm_end == ranges[i][1]);
+        assert(vma->vm_flags == flags[i]);
+        i++;
+    }
+    assert(i == n && mm->map_count == n);
+}
+
+static void
+check_vma_merge_split(void)
+{
+    struct mm_struct *mm = mm_create();
+    assert(mm != NULL);
+
+    uint32_t rw = VM_READ | VM_WRITE, ro = VM_READ;
+    uintptr_t base = UTEXT;
+    struct vma_struct *vma;
+
+    // a heap grown in steps stays one vma
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        assert(mm_brk(mm, base + i * PGSIZE, PGSIZE) == 0);
+    }
+    uintptr_t l1[][2] = {{base, base + 8 * PGSIZE}};
+    uint32_t f1[] = {rw};
+    check_vma_layout(mm, 1, l1, f1);
+
+    // filling a hole merges with both neighbours
+    assert(mm_map(mm, base + 10 * PGSIZE, 2 * PGSIZE, rw, NULL) == 0);
+    assert(mm_map(mm, base + 8 * PGSIZE, 2 * PGSIZE, rw, &vma) == 0);
+    assert(vma->vm_start == base && vma->vm_end == base + 12 * PGSIZE);
+    assert(find_vma(mm, base + 11 * PGSIZE) == vma);
+    assert(mm->map_count == 1);
+
+    // different flags never merge
+    assert(mm_map(mm, base + 12 * PGSIZE, PGSIZE, ro, NULL) == 0);
+    assert(mm->map_count == 2);
+
+    // protection change in the middle splits into three
+    assert(mm_protect(mm, base + 2 * PGSIZE, 2 * PGSIZE, ro) == 0);
+    uintptr_t l2[][2] = {{base, base + 2 * PGSIZE}, {base + 2 * PGSIZE, base + 4 * PGSIZE},
+                         {base + 4 * PGSIZE, base + 12 * PGSIZE}, {base + 12 * PGSIZE, base + 13 * PGSIZE}};
+    uint32_t f2[] = {rw, ro, rw, ro};
+    check_vma_layout(mm, 4, l2, f2);
+
+    // and changing it back merges them again
+    assert(mm_protect(mm, base + 2 * PGSIZE, 2 * PGSIZE, rw) == 0);
+    uintptr_t l3[][2] = {{base, base + 12 * PGSIZE}, {base + 12 * PGSIZE, base + 13 * PGSIZE}};
+    uint32_t f3[] = {rw, ro};
+    check_vma_layout(mm, 2, l3, f3);
+
+    // protecting an unmapped range fails and changes nothing
+    assert(mm_protect(mm, base + 12 * PGSIZE, 2 * PGSIZE, rw) != 0);
+    check_vma_layout(mm, 2, l3, f3);
+
+    // partial unmaps split
+    assert(mm_unmap(mm, base + 5 * PGSIZE, PGSIZE) == 0);
+    assert(mm_unmap(mm, base, PGSIZE) == 0);
+    assert(mm_unmap(mm, base + 11 * PGSIZE, 2 * PGSIZE) == 0);
+    uintptr_t l4[][2] = {{base + PGSIZE, base + 5 * PGSIZE}, {base + 6 * PGSIZE, base + 11 * PGSIZE}};
+    uint32_t f4[] = {rw, rw};
+    check_vma_layout(mm, 2, l4, f4);
+    assert(find_vma(mm, base + 5 * PGSIZE) == NULL);
+
+    assert(mm_unmap(mm, base, 16 * PGSIZE) == 0);
+    assert(mm->map_count == 0 && list_empty(&(mm->mmap_list)));
+
+    mm_destroy(mm);
+
+    cprintf("check_vma_merge_split() succeeded!\n");
+}
+
+// how a fault was resolved, fault_around does the same to the neighbours
+#define FAULT_ABSENT 0 // a fresh zeroed page
+#define FAULT_ZERO 1   // the zero page
+#define FAULT_COW 2    // a private copy of a PTE_COW page
+
+// the zero page is mapped read-only, and PTE_COW even in a read-only vma so that
+// mm_protect never makes it writable
+#define ZERO_PAGE_PERM(perm) (((perm) & ~PTE_W) | PTE_COW)
+
+// copy_cow_page - fill the private copy of a COW page, a copy of the zero page needs no reads
+static inline void
+copy_cow_page(struct Page *to, struct Page *from)
+{
+    if (from == zero_page)
+    {
+        memset(page2kva(to), 0, PGSIZE);
+    }
+    else
+    {
+        memcpy(page2kva(to), page2kva(from), PGSIZE);
+    }
+}
+
+// fault_around - after a fault at addr was resolved, do the same for the other pages
+//              - of its vm_fault_around aligned window: zero-fill the absent ones or map
+//              - the zero page there as the fault did, or break COW on the present
+//              - ones if it was a COW fault.
+//              - the window is clipped to the vma and lies in the PT holding ptep
+//              - (private to the faulting mm by now), so neighbours are reached by
+//              - indexing ptep, and the TLB is flushed once at the end: like page_insert,
+//              - even an invalid -> valid change needs an sfence.vma to be seen
+static void
+fault_around(struct vma_struct *vma, uintptr_t addr, pte_t *ptep, int how)
+{
+    size_t size = vma->vm_fault_around * PGSIZE;
+    uintptr_t start = ROUNDDOWN(addr, size), end = start + size;
+    start = (start > vma->vm_start) ? start : vma->vm_start;
+    end = (end < vma->vm_end) ? end : vma->vm_end;
+    // size is a power of 2 no bigger than PTSIZE, so the aligned window never crosses a PT
+    static_assert(FAULT_AROUND_MAX <= NPTEENTRY);
+
+    uint32_t perm = vma_perm(vma);
+    bool flush = 0;
+    uintptr_t la;
+    fault_stats.around++;
+    for (la = start; la < end; la += PGSIZE)
+    {
+        if (la == addr)
+        {
+            continue;
+        }
+        pte_t *nptep = ptep + ((intptr_t)la - (intptr_t)addr) / PGSIZE;
+        struct Page *page, *npage;
+        if (how == FAULT_ZERO && *nptep == 0)
+        {
+            page_ref_inc(zero_page);
+            *nptep = pte_create(page2ppn(zero_page), PTE_V | ZERO_PAGE_PERM(perm));
+            fault_stats.around_mapped++;
+            flush = 1;
+        }
+        else if (how == FAULT_ABSENT && *nptep == 0)
+        {
+            if ((npage = alloc_page()) == NULL)
+            {
+                goto nomem;
+            }
+            memset(page2kva(npage), 0, PGSIZE);
+            set_page_ref(npage, 1);
+            *nptep = pte_create(page2ppn(npage), PTE_V | perm);
+            fault_stats.around_mapped++;
+            flush = 1;
+        }
+        else if (how == FAULT_COW && (*nptep & (PTE_V | PTE_W | PTE_COW)) == (PTE_V | PTE_COW))
+        {
+            page = pte2page(*nptep);
+            uint32_t nperm = (*nptep & PTE_USER) | PTE_W;
+            if (page_ref(page) > 1)
+            {
+                if ((npage = alloc_page()) == NULL)
+                {
+                    goto nomem;
+                }
+                copy_cow_page(npage, page);
+                set_page_ref(npage, 1);
+                page_ref_dec(page);
+                page = npage;
+            }
+            *nptep = pte_create(page2ppn(page), PTE_V | nperm);
+            fault_stats.around_cow++;
+            flush = 1;
+        }
+        else
+        {
+            fault_stats.around_missed++;
+        }
+    }
+out:
+    if (flush)
+    {
+        flush_tlb();
+    }
+    return;
+nomem:
+    fault_stats.around_nomem++;
+    goto out;
+}
+
+// print_fault_stats - print the counters of do_pgfault
+void print_fault_stats(void)
+{
+    cprintf("page faults: %llu resolved, %llu by the zero page, %llu with fault-around\n", fault_stats.faults,
+            fault_stats.zero, fault_stats.around);
+    cprintf("fault-around: %llu zero-filled, %llu cow broken, %llu missed, %llu out of memory\n",
+            fault_stats.around_mapped, fault_stats.around_cow, fault_stats.around_missed,
+            fault_stats.around_nomem);
+}
+
+// do_pgfault - interrupt handler to process the page fault execption
+// @mm         : the control struct for a set of vma using the same PDT
+// @error_code : the scause of the fault, CAUSE_{FETCH,LOAD,STORE}_PAGE_FAULT
+// @addr       : the addr which causes a memory access exception, (the contents of the stval register)
+//
+// A fault below a VM_STACK vma grows the stack (see expand_stack). A fault on an
+// unmapped page inside a vma gets a fresh zeroed page, and a write fault on a
+// PTE_COW page gets a private copy. Either is done for the neighbours of the page
+// too if the vma asks for it (see fault_around).
+int do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr)
+{
+    int ret = -E_INVAL;
+    struct vma_struct *vma = find_vma(mm, addr);
+
+    pgfault_num++;
+    if (vma == NULL && (vma = expand_stack(mm, addr)) == NULL)
+    {
+        goto failed;
+    }
+
+    bool write = (error_code == CAUSE_STORE_PAGE_FAULT);
+    switch (error_code)
+    {
+    case CAUSE_STORE_PAGE_FAULT:
+        if (!(vma->vm_flags & VM_WRITE))
+        {
+            goto failed;
+        }
+        break;
+    case CAUSE_FETCH_PAGE_FAULT:
+        if (!(vma->vm_flags & VM_EXEC))
+        {
+            goto failed;
+        }
+        break;
+    default: /* CAUSE_LOAD_PAGE_FAULT */
+        if (!(vma->vm_flags & (VM_READ | VM_EXEC)))
+        {
+            goto failed;
+        }
+    }
+
+    uint32_t perm = vma_perm(vma);
+    addr = ROUNDDOWN(addr, PGSIZE);
+
+    ret = -E_NO_MEM;
+
+    pte_t *ptep;
+    if ((ptep = get_pte(mm->pgdir, addr, 1)) == NULL)
+    {
+        goto failed;
+    }
+
+    trace(TRACE_DEBUG, TRACE_MM, "do_pgfault: addr 0x%x, cause %d, pte 0x%x\n", addr, error_code, *ptep);
+
+    int how = FAULT_ABSENT;
+    if (*ptep == 0 && error_code == CAUSE_LOAD_PAGE_FAULT && !(vma->vm_flags & VM_SHARED))
+    {
+        // nothing was written here yet, so there is nothing to copy either
+        if (page_insert(mm->pgdir, zero_page, addr, ZERO_PAGE_PERM(perm)) != 0)
+        {
+            goto failed;
+        }
+        how = FAULT_ZERO;
+        fault_stats.zero++;
+    }
+    else if (*ptep == 0)
+    {
+        struct Page *page;
+        if ((page = pgdir_alloc_page(mm->pgdir, addr, perm)) == NULL)
+        {
+            goto failed;
+        }
+        memset(page2kva(page), 0, PGSIZE);
+    }
+    else if (write && (*ptep & PTE_V) && !(*ptep & PTE_W) && (*ptep & PTE_COW))
+    {
+        struct Page *page = pte2page(*ptep);
+        how = FAULT_COW;
+
+        // 如果页面被多个进程共享，则复制 (the zero page always is)
+        if (page_ref(page) > 1)
+        {
+            trace(TRACE_DEBUG, TRACE_MM, "do_pgfault: cow copy 0x%x, ref %d\n", addr, page_ref(page));
+            struct Page *npage = alloc_page();
+            if (npage == NULL)
+            {
+                goto failed;
+            }
+            copy_cow_page(npage, page);
+            // page_insert drops the reference this pte held on the shared page
+            if (page_insert(mm->pgdir, npage, addr, (*ptep & PTE_USER) | PTE_W) != 0)
+            {
+                free_page(npage);
+                goto failed;
+            }
+        }
+        // 如果页面只被当前进程引用，直接设为可写
+        else
+        {
+            if (page_insert(mm->pgdir, page, addr, (*ptep & PTE_USER) | PTE_W) != 0)
+            {
+                goto failed;
+            }
+            trace(TRACE_DEBUG, TRACE_MM, "do_pgfault: cow reuse 0x%x\n", addr);
+        }
+    }
+    else
+    {
+        ret = -E_INVAL;
+        goto failed;
+    }
+    fault_stats.faults++;
+    if (vma->vm_fault_around > 1)
+    {
+        fault_around(vma, addr, ptep, how);
+    }
+    ret = 0;
+failed:
+    if (ret != 0)
+    {
+        trace(TRACE_ERROR, TRACE_MM, "do_pgfault: addr 0x%x, cause %d failed %e\n", addr, error_code, ret);
+    }
+    return ret;
+}
+bool user_mem_check(struct mm_struct *mm, uintptr_t addr, size_t len, bool write)
+{
+    if (mm != NULL)
+    {
+        if (!USER_ACCESS(addr, addr + len))
+        {
+            return 0;
+        }
+        struct vma_struct *vma;
+        uintptr_t start = addr, end = addr + len;
+        while (start < end)
+        {
+            // the part below a stack vma is fine if the stack could grow there
+            if ((vma = find_vma(mm, start)) == NULL && (vma = find_stack_vma(mm, start)) == NULL)
+            {
+                return 0;
+            }
+            if (!(vma->vm_flags & ((write) ? VM_WRITE : VM_READ)))
+            {
+                return 0;
             }
             start = vma->vm_end;
         }
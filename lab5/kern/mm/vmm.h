@@ -5,6 +5,8 @@
 #include <list.h>
 #include <memlayout.h>
 #include <sync.h>
+#include <mutex.h>
+#include <workqueue.h>
 
 // pre define
 struct mm_struct;
@@ -17,6 +19,7 @@ struct vma_struct
     uintptr_t vm_start;      // start addr of vma
     uintptr_t vm_end;        // end addr of vma, not include the vm_end itself
     uint32_t vm_flags;       // flags of vma
+    size_t vm_fault_around;  // # of pages resolved together around a fault, 1 for none
     list_entry_t list_link;  // linear list link which sorted by start addr of vma
 };
 
@@ -27,6 +30,31 @@ struct vma_struct
 #define VM_WRITE 0x00000002
 #define VM_EXEC 0x00000004
 #define VM_STACK 0x00000008
+#define VM_SHARED 0x00000010
+
+#define VM_PROT (VM_READ | VM_WRITE | VM_EXEC)
+
+#define FAULT_AROUND_DEFAULT 4 // vm_fault_around of new vmas
+#define FAULT_AROUND_MAX 64    // a power of 2 no bigger than NPTEENTRY
+
+// counters of do_pgfault and its fault-around
+struct fault_stats
+{
+    size_t faults;        // page faults resolved
+    size_t zero;          // read faults served by the zero page
+    size_t around;        // faults in vmas with vm_fault_around > 1
+    size_t around_mapped; // absent neighbours zero-filled or given the zero page
+    size_t around_cow;    // COW neighbours broken
+    size_t around_missed; // neighbours in the window left alone
+    size_t around_nomem;  // windows cut short by a failed allocation
+};
+
+extern struct fault_stats fault_stats;
+
+// the zeroed frame every read fault on untouched private memory maps read-only
+// and PTE_COW, so that a later write copies it like any COW page. the kernel
+// holds a reference of its own, so it is never freed
+extern struct Page *zero_page;
 
 // the control struct for a set of vma using the same PDT
 struct mm_struct
@@ -37,24 +65,55 @@ struct mm_struct
     int map_count;                 // the count of these vma
     void *sm_priv;                 // the private data for swap manager
     int mm_count;                  // the number ofprocess which shared the mm
-    lock_t mm_lock;                // mutex for using dup_mmap fun to duplicat the mm
+    mutex_t mm_lock;               // mutex for using dup_mmap fun to duplicat the mm
+    size_t stack_limit;            // the max size the VM_STACK vma may grow down to
+    struct work_struct reap_work;  // frees the mm in the background, see exit_mm
+};
+
+// exit_mm frees the memory of exited processes in a worker thread unless
+// mm_reap_async is off, e.g. for tests wanting the frames back right away
+#ifndef MM_REAP_ASYNC
+#define MM_REAP_ASYNC 1
+#endif
+
+struct reap_stats
+{
+    size_t queued; // mms handed to mm_reaper_wq
+    size_t reaped; // of those, freed
+    size_t sync;   // mms freed by exit_mm itself
+    size_t yields; // times the reaper gave the cpu away halfway
 };
 
+extern bool mm_reap_async;
+extern struct reap_stats reap_stats;
+
 struct vma_struct *find_vma(struct mm_struct *mm, uintptr_t addr);
 struct vma_struct *vma_create(uintptr_t vm_start, uintptr_t vm_end, uint32_t vm_flags);
-void insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma);
+struct vma_struct *insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma);
+struct vma_struct *expand_stack(struct mm_struct *mm, uintptr_t addr);
 
 struct mm_struct *mm_create(void);
 void mm_destroy(struct mm_struct *mm);
 
 void vmm_init(void);
+int do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr);
 int mm_map(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags,
            struct vma_struct **vma_store);
 int mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len);
+int mm_protect(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags);
+int mm_fault_around(struct mm_struct *mm, uintptr_t addr, size_t len, size_t pages);
 int dup_mmap(struct mm_struct *to, struct mm_struct *from);
 void exit_mmap(struct mm_struct *mm);
+void exit_mm(struct mm_struct *mm);
+void mm_reap(struct mm_struct *mm, bool resched);
+void mm_recycle(struct mm_struct *mm);
+void mm_reap_init(void);
+void print_reap_stats(void);
 uintptr_t get_unmapped_area(struct mm_struct *mm, size_t len);
 int mm_brk(struct mm_struct *mm, uintptr_t addr, size_t len);
+void print_mm(struct mm_struct *mm);
+void print_fault_stats(void);
+int mm_populate(struct mm_struct *mm, uintptr_t start, uintptr_t end);
 
 extern volatile unsigned int pgfault_num;
 extern struct mm_struct *check_mm_struct;
@@ -94,7 +153,7 @@ lock_mm(struct mm_struct *mm)
 {
     if (mm != NULL)
     {
-        lock(&(mm->mm_lock));
+        mutex_lock(&(mm->mm_lock));
     }
 }
 
@@ -103,7 +162,7 @@ unlock_mm(struct mm_struct *mm)
 {
     if (mm != NULL)
     {
-        unlock(&(mm->mm_lock));
+        mutex_unlock(&(mm->mm_lock));
     }
 }
 
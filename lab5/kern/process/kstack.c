@@ -0,0 +1,183 @@
+#include <defs.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sync.h>
+#include <pmm.h>
+#include <kstack.h>
+
+/* *
+ * Kernel stack cache. Every fork allocates KSTACKPAGE pages for the kernel
+ * stack of the child and every reaped process frees them, so the stacks
+ * of dead processes are kept here and handed to the next ones without
+ * going through the pmm. The cache would be per cpu, ucore runs on one
+ * hart so there is a single one, used with interrupts off. Stacks go back
+ * to the pmm when the cache is full, when free memory is low, and when
+ * alloc_pages runs out and calls the shrinker.
+ * */
+
+struct kstack_cache
+{
+    int nr_stacks;                        // stacks in the cache
+    void *stacks[KSTACK_CACHE_SIZE];      // the free stacks, last freed on top
+    struct kstack_stats stats;
+};
+
+static struct kstack_cache kstack_cache;
+
+static size_t kstack_shrink(size_t nr_pages);
+
+static struct shrinker kstack_shrinker = {
+    .name = "kstack",
+    .shrink = kstack_shrink,
+};
+
+static void check_kstack(void);
+
+// kstack_alloc - a kernel stack of KSTACKPAGE pages, the last one freed if
+//              - the cache has any, NULL if out of memory
+void *kstack_alloc(void)
+{
+    void *kstack = NULL;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (kstack_cache.nr_stacks > 0)
+        {
+            kstack = kstack_cache.stacks[--kstack_cache.nr_stacks];
+            kstack_cache.stats.hits++;
+        }
+        else
+        {
+            kstack_cache.stats.misses++;
+        }
+    }
+    local_intr_restore(intr_flag);
+
+    if (kstack == NULL)
+    {
+        struct Page *page;
+        if ((page = alloc_pages(KSTACKPAGE)) != NULL)
+        {
+            kstack = page2kva(page);
+        }
+    }
+    return kstack;
+}
+
+// kstack_free - put a stack from kstack_alloc in the cache, or give it
+//             - back to the pmm if the cache is full or memory is low
+void kstack_free(void *kstack)
+{
+    bool intr_flag, cached = 0;
+    local_intr_save(intr_flag);
+    {
+        if (kstack_cache.nr_stacks < KSTACK_CACHE_SIZE && nr_free_pages() >= KSTACK_LOW_PAGES)
+        {
+            kstack_cache.stacks[kstack_cache.nr_stacks++] = kstack;
+            kstack_cache.stats.cached++;
+            cached = 1;
+        }
+        else
+        {
+            kstack_cache.stats.freed++;
+        }
+    }
+    local_intr_restore(intr_flag);
+
+    if (!cached)
+    {
+        free_pages(kva2page(kstack), KSTACKPAGE);
+    }
+}
+
+// kstack_shrink - the shrinker: free cached stacks, the oldest first, until
+//               - nr_pages pages are freed or the cache is empty
+static size_t
+kstack_shrink(size_t nr_pages)
+{
+    size_t freed = 0;
+    while (freed < nr_pages)
+    {
+        void *kstack = NULL;
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        {
+            if (kstack_cache.nr_stacks > 0)
+            {
+                kstack = kstack_cache.stacks[0];
+                memmove(kstack_cache.stacks, kstack_cache.stacks + 1,
+                        --kstack_cache.nr_stacks * sizeof(void *));
+                kstack_cache.stats.trimmed++;
+            }
+        }
+        local_intr_restore(intr_flag);
+
+        if (kstack == NULL)
+        {
+            break;
+        }
+        free_pages(kva2page(kstack), KSTACKPAGE);
+        freed += KSTACKPAGE;
+    }
+    return freed;
+}
+
+void print_kstack_stats(void)
+{
+    struct kstack_stats *stats = &(kstack_cache.stats);
+    size_t allocs = stats->hits + stats->misses;
+    cprintf("kstack: %d of %d cached, %llu allocs, %llu hits (%llu%%), %llu misses\n",
+            kstack_cache.nr_stacks, KSTACK_CACHE_SIZE, allocs, stats->hits,
+            allocs == 0 ? 0 : stats->hits * 100 / allocs, stats->misses);
+    cprintf("kstack: %llu frees, %llu cached, %llu freed, %llu trimmed\n",
+            stats->cached + stats->freed, stats->cached, stats->freed, stats->trimmed);
+}
+
+// kstack_init - let alloc_pages trim the cache when it runs out of memory
+void kstack_init(void)
+{
+    register_shrinker(&kstack_shrinker);
+    check_kstack();
+}
+
+static void
+check_kstack(void)
+{
+    size_t nr_free_pages_store = nr_free_pages();
+    void *stacks[KSTACK_CACHE_SIZE + 1];
+    int i;
+    assert(kstack_cache.nr_stacks == 0);
+
+    // a freed stack is the next one handed out
+    void *kstack = kstack_alloc();
+    assert(kstack != NULL && kstack_cache.stats.misses == 1);
+    kstack_free(kstack);
+    assert(kstack_cache.nr_stacks == 1 && nr_free_pages() == nr_free_pages_store - KSTACKPAGE);
+    assert(kstack_alloc() == kstack && kstack_cache.stats.hits == 1);
+    kstack_free(kstack);
+
+    // the cache keeps KSTACK_CACHE_SIZE stacks, the rest go back to the pmm
+    for (i = 0; i <= KSTACK_CACHE_SIZE; i++)
+    {
+        assert((stacks[i] = kstack_alloc()) != NULL);
+    }
+    assert(kstack_cache.nr_stacks == 0 && kstack_cache.stats.hits == 2);
+    for (i = 0; i <= KSTACK_CACHE_SIZE; i++)
+    {
+        kstack_free(stacks[i]);
+    }
+    assert(kstack_cache.nr_stacks == KSTACK_CACHE_SIZE && kstack_cache.stats.freed == 1);
+    assert(nr_free_pages() == nr_free_pages_store - KSTACK_CACHE_SIZE * KSTACKPAGE);
+
+    // the shrinker frees stacks oldest first, as many as asked for
+    assert(shrink_caches(KSTACKPAGE + 1) == 2 * KSTACKPAGE);
+    assert(kstack_cache.nr_stacks == KSTACK_CACHE_SIZE - 2 && kstack_cache.stacks[0] == stacks[2]);
+    assert(shrink_caches(KSTACK_CACHE_SIZE * KSTACKPAGE) == (KSTACK_CACHE_SIZE - 2) * KSTACKPAGE);
+    assert(kstack_cache.nr_stacks == 0 && kstack_cache.stats.trimmed == KSTACK_CACHE_SIZE);
+    assert(shrink_caches(1) == 0);
+    assert(nr_free_pages() == nr_free_pages_store);
+
+    memset(&(kstack_cache.stats), 0, sizeof(struct kstack_stats));
+    cprintf("check_kstack() succeeded!\n");
+}
@@ -0,0 +1,25 @@
+#ifndef __KERN_PROCESS_KSTACK_H__
+#define __KERN_PROCESS_KSTACK_H__
+
+#include <defs.h>
+
+// freed kernel stacks are kept for the next fork, up to KSTACK_CACHE_SIZE,
+// unless fewer than KSTACK_LOW_PAGES pages are free
+#define KSTACK_CACHE_SIZE 32
+#define KSTACK_LOW_PAGES 256
+
+struct kstack_stats
+{
+    size_t hits;    // kstack_alloc served from the cache
+    size_t misses;  // kstack_alloc that went to alloc_pages
+    size_t cached;  // kstack_free kept in the cache
+    size_t freed;   // kstack_free given back to the pmm, cache full or memory low
+    size_t trimmed; // cached stacks given back by the shrinker
+};
+
+void kstack_init(void);
+void *kstack_alloc(void);
+void kstack_free(void *kstack);
+void print_kstack_stats(void);
+
+#endif /* !__KERN_PROCESS_KSTACK_H__ */
@@ -0,0 +1,206 @@
+#include <defs.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <error.h>
+#include <kmalloc.h>
+#include <pid.h>
+
+/* *
+ * PID allocation. alloc_pid goes on from the last pid handed out, so pids
+ * are not reused soon, and looks for a clear bit a 64-bit word at a time,
+ * skipping whole pidmaps without free pids, which makes it O(1) amortized
+ * however many processes there are. find_proc is two array lookups.
+ * */
+
+#define PIDMAP_WORDS (PIDMAP_PIDS / 64)
+
+struct pidmap
+{
+    int nr_free;                 // pids of this map not in use
+    uint64_t bits[PIDMAP_WORDS]; // bit set for a pid in use
+    struct proc_struct **procs;  // the proc of each pid, NULL for none
+};
+
+static struct pidmap *pidmaps[PID_MAX_LIMIT / PIDMAP_PIDS];
+static int last_pid;
+static int nr_pidmaps;
+int pid_max = PID_MAX_DEFAULT;
+
+static void check_pid(void);
+
+// get_pidmap - the pidmap of pid, allocate it on first use if create
+static struct pidmap *
+get_pidmap(int pid, bool create)
+{
+    struct pidmap **mapp = &pidmaps[pid / PIDMAP_PIDS];
+    if (*mapp == NULL && create)
+    {
+        struct pidmap *map;
+        if ((map = kmalloc(sizeof(struct pidmap))) == NULL)
+        {
+            return NULL;
+        }
+        if ((map->procs = kmalloc(PIDMAP_PIDS * sizeof(struct proc_struct *))) == NULL)
+        {
+            kfree(map);
+            return NULL;
+        }
+        map->nr_free = PIDMAP_PIDS;
+        memset(map->bits, 0, sizeof(map->bits));
+        memset(map->procs, 0, PIDMAP_PIDS * sizeof(struct proc_struct *));
+        *mapp = map;
+        nr_pidmaps++;
+    }
+    return *mapp;
+}
+
+// pidmap_find_free - the first free pid of map at index off or above, -1 if none
+static int
+pidmap_find_free(struct pidmap *map, int off)
+{
+    int i = off / 64;
+    // pids below off in the first word count as used
+    uint64_t used = map->bits[i] | ((1ULL << (off % 64)) - 1);
+    while (used == ~0ULL)
+    {
+        if (++i == PIDMAP_WORDS)
+        {
+            return -1;
+        }
+        used = map->bits[i];
+    }
+    return i * 64 + __builtin_ctzll(~used);
+}
+
+// alloc_pid - alloc a unique pid for process
+// return value: the pid, or -E_NO_FREE_PROC / -E_NO_MEM
+int alloc_pid(void)
+{
+    int pid = last_pid + 1, nr_maps = pid_max / PIDMAP_PIDS, i;
+    // the map of the last pid is looked at twice: above it first, then below it after wrapping
+    for (i = 0; i <= nr_maps; i++)
+    {
+        if (pid >= pid_max)
+        {
+            pid = 1;
+        }
+        struct pidmap *map;
+        if ((map = get_pidmap(pid, 1)) == NULL)
+        {
+            return -E_NO_MEM;
+        }
+        int off;
+        if (map->nr_free > 0 && (off = pidmap_find_free(map, pid % PIDMAP_PIDS)) >= 0)
+        {
+            map->bits[off / 64] |= 1ULL << (off % 64);
+            map->nr_free--;
+            last_pid = pid - pid % PIDMAP_PIDS + off;
+            return last_pid;
+        }
+        pid = pid - pid % PIDMAP_PIDS + PIDMAP_PIDS;
+    }
+    return -E_NO_FREE_PROC;
+}
+
+// free_pid - give back a pid from alloc_pid
+void free_pid(int pid)
+{
+    struct pidmap *map = get_pidmap(pid, 0);
+    int off = pid % PIDMAP_PIDS;
+    assert(map != NULL && (map->bits[off / 64] & (1ULL << (off % 64))) && map->procs[off] == NULL);
+    map->bits[off / 64] &= ~(1ULL << (off % 64));
+    map->nr_free++;
+}
+
+// pid_set_proc - let find_proc(pid) return proc, the pid must be in use
+void pid_set_proc(int pid, struct proc_struct *proc)
+{
+    struct pidmap *map = get_pidmap(pid, 0);
+    assert(map != NULL);
+    map->procs[pid % PIDMAP_PIDS] = proc;
+}
+
+struct proc_struct *
+pid_find_proc(int pid)
+{
+    struct pidmap *map;
+    if (0 < pid && pid < PID_MAX_LIMIT && (map = get_pidmap(pid, 0)) != NULL)
+    {
+        return map->procs[pid % PIDMAP_PIDS];
+    }
+    return NULL;
+}
+
+// set_pid_max - change the pid space to [1, max), max is rounded up to a
+//             - multiple of PIDMAP_PIDS. pids in use above it stay valid
+int set_pid_max(int max)
+{
+    max = ROUNDUP(max, PIDMAP_PIDS);
+    if (max < 2 * PIDMAP_PIDS || max > PID_MAX_LIMIT)
+    {
+        return -E_INVAL;
+    }
+    pid_max = max;
+    return 0;
+}
+
+void print_pid_stats(void)
+{
+    int i, nr_maps = PID_MAX_LIMIT / PIDMAP_PIDS, used = 0;
+    for (i = 0; i < nr_maps; i++)
+    {
+        if (pidmaps[i] != NULL)
+        {
+            used += PIDMAP_PIDS - pidmaps[i]->nr_free;
+        }
+    }
+    cprintf("pid: max %d, %d in use, last %d, %d pidmaps of %d pids\n",
+            pid_max, used, last_pid, nr_pidmaps, PIDMAP_PIDS);
+}
+
+// pid_init - reserve pid 0 for idleproc
+void pid_init(void)
+{
+    check_pid();
+
+    struct pidmap *map = get_pidmap(0, 1);
+    assert(map != NULL);
+    map->bits[0] |= 1;
+    map->nr_free--;
+}
+
+static void
+check_pid(void)
+{
+    int pid_max_store = pid_max, pid, i;
+    assert(set_pid_max(PIDMAP_PIDS) != 0 && set_pid_max(PIDMAP_PIDS + 1) == 0);
+    assert(pid_max == 2 * PIDMAP_PIDS);
+
+    // pids come in order, up to the whole space but pid 0
+    for (i = 1; i < pid_max; i++)
+    {
+        assert(alloc_pid() == i);
+    }
+    assert(alloc_pid() == -E_NO_FREE_PROC);
+
+    // then wrap around to the lowest free one, and on from there
+    free_pid(PIDMAP_PIDS + 3);
+    free_pid(5);
+    assert(alloc_pid() == 5 && alloc_pid() == PIDMAP_PIDS + 3);
+    assert(alloc_pid() == -E_NO_FREE_PROC);
+
+    pid_set_proc(7, (struct proc_struct *)&pid);
+    assert(pid_find_proc(7) == (struct proc_struct *)&pid && pid_find_proc(8) == NULL);
+    assert(pid_find_proc(0) == NULL && pid_find_proc(pid_max + PIDMAP_PIDS) == NULL);
+    pid_set_proc(7, NULL);
+
+    for (i = 1; i < pid_max; i++)
+    {
+        free_pid(i);
+    }
+    assert(pidmaps[0]->nr_free == PIDMAP_PIDS && pidmaps[1]->nr_free == PIDMAP_PIDS);
+    pid_max = pid_max_store, last_pid = 0;
+
+    cprintf("check_pid() succeeded!\n");
+}
@@ -0,0 +1,26 @@
+#ifndef __KERN_PROCESS_PID_H__
+#define __KERN_PROCESS_PID_H__
+
+#include <defs.h>
+#include <mmu.h>
+
+struct proc_struct;
+
+// the pid space is cut into pidmaps, each with a bitmap of the pids in use
+// and the proc of each of them, allocated the first time a pid in it is
+#define PIDMAP_PIDS (PGSIZE / sizeof(struct proc_struct *)) // pids of a pidmap
+#define PID_MAX_LIMIT (1 << 21)                             // the largest pid_max
+#define PID_MAX_DEFAULT 65536                               // pid_max at boot
+
+// pids are allocated in [1, pid_max), a multiple of PIDMAP_PIDS
+extern int pid_max;
+
+void pid_init(void);
+int alloc_pid(void);
+void free_pid(int pid);
+void pid_set_proc(int pid, struct proc_struct *proc);
+struct proc_struct *pid_find_proc(int pid);
+int set_pid_max(int max);
+void print_pid_stats(void);
+
+#endif /* !__KERN_PROCESS_PID_H__ */
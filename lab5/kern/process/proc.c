@@ -12,6 +12,14 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
+#include <trace.h>
+#include <ksm.h>
+#include <pid.h>
+#include <kstack.h>
+#include <workqueue.h>
+#include <initrd.h>
+#include <template.h>
+#include <mutex.h>
 
 /* ------------- process/thread mechanism design&implementation -------------
 (an simplified Linux process/thread mechanism )
@@ -40,17 +48,19 @@ PROC_UNINIT -- proc_init/wakeup_proc --> PROC_RUNNABLE -- try_free_pages/do_wait
                                            -----------------------wakeup_proc----------------------------------
 -----------------------------
 process relations
-parent:           proc->parent  (proc is children)
-children:         proc->cptr    (proc is parent)
-older sibling:    proc->optr    (proc is younger sibling)
-younger sibling:  proc->yptr    (proc is older sibling)
+parent:           proc->parent  (proc is children, see proc_parent)
+children:         proc->children (proc is parent, children still running)
+zombies:          proc->zombies (proc is parent, children exited but not reaped)
+siblings:         proc->child_link (in the children or zombies list of the parent)
+threads:          proc->thread_group (the threads cloned with CLONE_THREAD, sharing the mm)
 -----------------------------
 related syscall for process:
-SYS_exit        : process exit,                           -->do_exit
+SYS_exit        : thread exit,                            -->do_exit
+SYS_exit_group  : process exit, with all its threads      -->do_exit_group-->do_exit
 SYS_fork        : create child process, dup mm            -->do_fork-->wakeup_proc
 SYS_wait        : wait process                            -->do_wait
-SYS_exec        : after fork, process execute a program   -->load a program and refresh the mm
-SYS_clone       : create child thread                     -->do_fork-->wakeup_proc
+SYS_exec        : after fork, process execute a program   -->find it in the initrd, load it and refresh the mm
+SYS_clone       : create child thread                     -->do_clone-->do_fork-->wakeup_proc
 SYS_yield       : process flag itself need resecheduling, -- proc->need_sched=1, then scheduler will rescheule this process
 SYS_sleep       : process sleep                           -->do_sleep
 SYS_kill        : kill process                            -->do_kill-->proc->flags |= PF_EXITING
@@ -62,13 +72,6 @@ SYS_getpid      : get the process's pid
 // the process set's list
 list_entry_t proc_list;
 
-#define HASH_SHIFT 10
-#define HASH_LIST_SIZE (1 << HASH_SHIFT)
-#define pid_hashfn(x) (hash32(x, HASH_SHIFT))
-
-// has list for process set based on pid
-static list_entry_t hash_list[HASH_LIST_SIZE];
-
 // idle proc
 struct proc_struct *idleproc = NULL;
 // init proc
@@ -78,6 +81,8 @@ struct proc_struct *current = NULL;
 
 static int nr_process = 0;
 
+bool exec_recycle = EXEC_RECYCLE;
+
 void kernel_thread_entry(void);
 void forkrets(struct trapframe *tf);
 void switch_to(struct context *from, struct context *to);
@@ -124,7 +129,6 @@ alloc_proc(void)
 
         // 链表初始化
         list_init(&(proc->list_link));
-        list_init(&(proc->hash_link));
         
         // LAB5 YOUR CODE : (update LAB4 steps)
         /*
@@ -133,10 +137,22 @@ alloc_proc(void)
          *       struct proc_struct *cptr, *yptr, *optr;     // relations between processes
          */
         proc->wait_state = 0;
-        proc->cptr = NULL;
-        proc->yptr = NULL;
-        proc->optr = NULL;
-        
+        proc->refs = 1;
+        list_init(&(proc->children));
+        list_init(&(proc->zombies));
+        list_init(&(proc->child_link));
+        wait_queue_init(&(proc->wait_child));
+        wait_queue_init(&(proc->vfork_done));
+        list_init(&(proc->thread_group));
+        proc->rq = NULL;
+        list_init(&(proc->run_link));
+        proc->time_slice = 0;
+        skew_heap_init(&(proc->run_pool));
+        proc->pass = 0;
+        proc->priority = DEFAULT_PRIORITY;
+        proc->vruntime = 0;
+        proc->exec_start = proc->slice_start = 0;
+        proc->mlfq_level = 0;
     }
     return proc;
 }
@@ -158,17 +174,40 @@ get_proc_name(struct proc_struct *proc)
     return memcpy(name, proc->name, PROC_NAME_LEN);
 }
 
+// put_proc - drop a reference to the proc_struct, free it with the last one
+static void
+put_proc(struct proc_struct *proc)
+{
+    if (--proc->refs == 0)
+    {
+        kfree(proc);
+    }
+}
+
+// proc_parent - get the parent of proc
+//             - do_exit hands the children of an exiting process over to
+//             - initproc by splicing its lists, so their parent pointers are
+//             - only moved to initproc here, the first time they are used
+static struct proc_struct *
+proc_parent(struct proc_struct *proc)
+{
+    struct proc_struct *parent = proc->parent;
+    if (parent->state == PROC_ZOMBIE)
+    {
+        proc->parent = initproc;
+        initproc->refs++;
+        put_proc(parent);
+    }
+    return proc->parent;
+}
+
 // set_links - set the relation links of process
 static void
 set_links(struct proc_struct *proc)
 {
     list_add(&proc_list, &(proc->list_link));
-    proc->yptr = NULL;
-    if ((proc->optr = proc->parent->cptr) != NULL)
-    {
-        proc->optr->yptr = proc;
-    }
-    proc->parent->cptr = proc;
+    list_add(&(proc->parent->children), &(proc->child_link));
+    proc->parent->refs++;
     nr_process++;
 }
 
@@ -177,64 +216,11 @@ static void
 remove_links(struct proc_struct *proc)
 {
     list_del(&(proc->list_link));
-    if (proc->optr != NULL)
-    {
-        proc->optr->yptr = proc->yptr;
-    }
-    if (proc->yptr != NULL)
-    {
-        proc->yptr->optr = proc->optr;
-    }
-    else
-    {
-        proc->parent->cptr = proc->optr;
-    }
+    list_del_init(&(proc->child_link));
+    put_proc(proc->parent);
     nr_process--;
 }
 
-// get_pid - alloc a unique pid for process
-static int
-get_pid(void)
-{
-    static_assert(MAX_PID > MAX_PROCESS);
-    struct proc_struct *proc;
-    list_entry_t *list = &proc_list, *le;
-    static int next_safe = MAX_PID, last_pid = MAX_PID;
-    if (++last_pid >= MAX_PID)
-    {
-        last_pid = 1;
-        goto inside;
-    }
-    if (last_pid >= next_safe)
-    {
-    inside:
-        next_safe = MAX_PID;
-    repeat:
-        le = list;
-        while ((le = list_next(le)) != list)
-        {
-            proc = le2proc(le, list_link);
-            if (proc->pid == last_pid)
-            {
-                if (++last_pid >= next_safe)
-                {
-                    if (last_pid >= MAX_PID)
-                    {
-                        last_pid = 1;
-                    }
-                    next_safe = MAX_PID;
-                    goto repeat;
-                }
-            }
-            else if (proc->pid > last_pid && next_safe > proc->pid)
-            {
-                next_safe = proc->pid;
-            }
-        }
-    }
-    return last_pid;
-}
-
 // proc_run - make process "proc" running on cpu
 // NOTE: before call switch_to, should load  base addr of "proc"'s new PDT
 void proc_run(struct proc_struct *proc)
@@ -276,37 +262,26 @@ forkret(void)
     forkrets(current->tf);
 }
 
-// hash_proc - add proc into proc hash_list
+// hash_proc - let find_proc find proc by its pid
 static void
 hash_proc(struct proc_struct *proc)
 {
-    list_add(hash_list + pid_hashfn(proc->pid), &(proc->hash_link));
+    pid_set_proc(proc->pid, proc);
 }
 
-// unhash_proc - delete proc from proc hash_list
+// unhash_proc - take proc out of the pid table and free its pid
 static void
 unhash_proc(struct proc_struct *proc)
 {
-    list_del(&(proc->hash_link));
+    pid_set_proc(proc->pid, NULL);
+    free_pid(proc->pid);
 }
 
-// find_proc - find proc frome proc hash_list according to pid
+// find_proc - find proc according to pid
 struct proc_struct *
 find_proc(int pid)
 {
-    if (0 < pid && pid < MAX_PID)
-    {
-        list_entry_t *list = hash_list + pid_hashfn(pid), *le = list;
-        while ((le = list_next(le)) != list)
-        {
-            struct proc_struct *proc = le2proc(le, hash_link);
-            if (proc->pid == pid)
-            {
-                return proc;
-            }
-        }
-    }
-    return NULL;
+    return pid_find_proc(pid);
 }
 
 // kernel_thread - create a kernel thread using "fn" function
@@ -323,24 +298,24 @@ int kernel_thread(int (*fn)(void *), void *arg, uint32_t clone_flags)
     return do_fork(clone_flags | CLONE_VM, 0, &tf);
 }
 
-// setup_kstack - alloc pages with size KSTACKPAGE as process kernel stack
+// setup_kstack - get a kernel stack of KSTACKPAGE pages from the kstack cache
 static int
 setup_kstack(struct proc_struct *proc)
 {
-    struct Page *page = alloc_pages(KSTACKPAGE);
-    if (page != NULL)
+    void *kstack = kstack_alloc();
+    if (kstack != NULL)
     {
-        proc->kstack = (uintptr_t)page2kva(page);
+        proc->kstack = (uintptr_t)kstack;
         return 0;
     }
     return -E_NO_MEM;
 }
 
-// put_kstack - free the memory space of process kernel stack
+// put_kstack - give the process kernel stack back to the kstack cache
 static void
 put_kstack(struct proc_struct *proc)
 {
-    free_pages(kva2page((void *)(proc->kstack)), KSTACKPAGE);
+    kstack_free((void *)(proc->kstack));
 }
 
 // setup_pgdir - alloc one page as PDT
@@ -366,19 +341,12 @@ put_pgdir(struct mm_struct *mm)
     free_page(kva2page(mm->pgdir));
 }
 
-// copy_mm - process "proc" duplicate OR share process "current"'s mm according clone_flags
-//         - if clone_flags & CLONE_VM, then "share" ; else "duplicate"
-static int
-copy_mm(uint32_t clone_flags, struct proc_struct *proc)
+// dup_mm - a new mm with the memory of oldmm, copy-on-write
+// return value: the new mm with mm_count 0, NULL if out of memory
+struct mm_struct *
+dup_mm(struct mm_struct *oldmm)
 {
-    struct mm_struct *mm, *oldmm = current->mm;
-
-    /* current is a kernel thread */
-    if (oldmm == NULL)
-    {
-        return 0;
-    }
-    int ret = -E_NO_MEM;
+    struct mm_struct *mm;
     if ((mm = mm_create()) == NULL)
     {
         goto bad_mm;
@@ -387,6 +355,7 @@ copy_mm(uint32_t clone_flags, struct proc_struct *proc)
     {
         goto bad_pgdir_cleanup_mm;
     }
+    int ret;
     lock_mm(oldmm);
     {
         ret = dup_mmap(mm, oldmm);
@@ -397,19 +366,41 @@ copy_mm(uint32_t clone_flags, struct proc_struct *proc)
     {
         goto bad_dup_cleanup_mmap;
     }
+    return mm;
 
-good_mm:
-    mm_count_inc(mm);
-    proc->mm = mm;
-    proc->pgdir = PADDR(mm->pgdir);
-    return 0;
 bad_dup_cleanup_mmap:
     exit_mmap(mm);
     put_pgdir(mm);
 bad_pgdir_cleanup_mm:
     mm_destroy(mm);
 bad_mm:
-    return ret;
+    return NULL;
+}
+
+// copy_mm - process "proc" duplicate OR share process "current"'s mm according clone_flags
+//         - if clone_flags & CLONE_VM, then "share" ; else "duplicate"
+static int
+copy_mm(uint32_t clone_flags, struct proc_struct *proc)
+{
+    struct mm_struct *mm, *oldmm = current->mm;
+
+    /* current is a kernel thread */
+    if (oldmm == NULL)
+    {
+        return 0;
+    }
+    if (clone_flags & CLONE_VM)
+    {
+        mm = oldmm;
+    }
+    else if ((mm = dup_mm(oldmm)) == NULL)
+    {
+        return -E_NO_MEM;
+    }
+    mm_count_inc(mm);
+    proc->mm = mm;
+    proc->pgdir = PADDR(mm->pgdir);
+    return 0;
 }
 
 // copy_thread - setup the trapframe on the  process's kernel stack top and
@@ -471,12 +462,16 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf)
     if ((proc = alloc_proc()) == NULL) {
         goto fork_out;
     }
+    if ((proc->pid = alloc_pid()) < 0) {
+        ret = proc->pid;
+        goto bad_fork_cleanup_proc;
+    }
     proc->parent = current;
     current->wait_state = 0;
 
     // 2. setup_kstack
     if (setup_kstack(proc) != 0) {
-        goto bad_fork_cleanup_proc;
+        goto bad_fork_cleanup_pid;
     }
 
     // 3. copy_mm
@@ -487,17 +482,45 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf)
     // 4. 复制寄存器上下文与设置 context
     copy_thread(proc, stack, tf);
 
-    // 5. 分配唯一 pid
-    proc->pid = get_pid();
+    // 5. 加入 pid 表（pid 已在第 1 步分配）
     hash_proc(proc);
     set_links(proc);
 
+    if (clone_flags & CLONE_THREAD)
+    {
+        list_add_before(&(current->thread_group), &(proc->thread_group));
+    }
+    if (clone_flags & CLONE_VFORK)
+    {
+        proc->flags |= PF_VFORK;
+    }
+
     // 6. 唤醒新建进程
     wakeup_proc(proc);
 
     // 7. 返回子进程的 pid
     ret = proc->pid;
 
+    // a vfork child runs on the parent's mm and user stack, so the parent
+    // must not return to user mode before the child execs or exits
+    if (clone_flags & CLONE_VFORK)
+    {
+        wait_t __wait, *wait = &__wait;
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        while (proc->flags & PF_VFORK)
+        {
+            wait_current_set(&(proc->vfork_done), wait, WT_VFORK);
+            local_intr_restore(intr_flag);
+
+            schedule();
+
+            local_intr_save(intr_flag);
+            wait_current_del(&(proc->vfork_done), wait);
+        }
+        local_intr_restore(intr_flag);
+    }
+
     // LAB5 YOUR CODE : (update LAB4 steps)
     // TIPS: you should modify your written code in lab4(step1 and step5), not add more code.
     /* Some Functions
@@ -512,13 +535,77 @@ fork_out:
 
 bad_fork_cleanup_kstack:
     put_kstack(proc);
+bad_fork_cleanup_pid:
+    free_pid(proc->pid);
 bad_fork_cleanup_proc:
     kfree(proc);
     goto fork_out;
 }
 
-// do_exit - called by sys_exit
-//   1. call exit_mmap & put_pgdir & mm_destroy to free the almost all memory space of process
+// vfork_release - a vfork child gives its parent's mm back: wake the parent up
+static void
+vfork_release(struct proc_struct *proc)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (proc->flags & PF_VFORK)
+        {
+            proc->flags &= ~PF_VFORK;
+            wakeup_all(&(proc->vfork_done), WT_VFORK, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+// kill_proc - make proc exit the next time it returns to user mode, waking it
+//           - up if it sleeps interruptibly
+// return value: 0, or -E_KILLED if it is exiting already
+static int
+kill_proc(struct proc_struct *proc)
+{
+    if (proc->flags & PF_EXITING)
+    {
+        return -E_KILLED;
+    }
+    proc->flags |= PF_EXITING;
+    if (proc->wait_state & WT_INTERRUPTED)
+    {
+        wakeup_proc(proc);
+    }
+    return 0;
+}
+
+// kill_threads - kill the other threads of the thread group of proc
+static void
+kill_threads(struct proc_struct *proc)
+{
+    list_entry_t *list = &(proc->thread_group), *le = list;
+    while ((le = list_next(le)) != list)
+    {
+        kill_proc(le2proc(le, thread_group));
+    }
+}
+
+// leave_thread_group - take current out of its thread group, the other
+//                    - threads are killed first if kill
+static void
+leave_thread_group(bool kill)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (kill)
+        {
+            kill_threads(current);
+        }
+        list_del_init(&(current->thread_group));
+    }
+    local_intr_restore(intr_flag);
+}
+
+// do_exit - called by sys_exit, exits the calling thread only
+//   1. call exit_mm to free the memory space of process, in the background by default
 //   2. set process' state as PROC_ZOMBIE, then call wakeup_proc(parent) to ask parent reclaim itself.
 //   3. call scheduler to switch to other process
 int do_exit(int error_code)
@@ -537,42 +624,30 @@ int do_exit(int error_code)
         lsatp(boot_pgdir_pa);
         if (mm_count_dec(mm) == 0)
         {
-            exit_mmap(mm);
-            put_pgdir(mm);
-            mm_destroy(mm);
+            exit_mm(mm);
         }
         current->mm = NULL;
     }
+    vfork_release(current);
+    leave_thread_group(0);
     current->state = PROC_ZOMBIE;
     current->exit_code = error_code;
     bool intr_flag;
     struct proc_struct *proc;
     local_intr_save(intr_flag);
     {
-        proc = current->parent;
-        if (proc->wait_state == WT_CHILD)
+        // move to the zombies of the parent, where do_wait finds it first
+        proc = proc_parent(current);
+        list_del(&(current->child_link));
+        list_add_before(&(proc->zombies), &(current->child_link));
+        wakeup_all(&(proc->wait_child), WT_CHILD, 1);
+
+        // and give the children to initproc in one go
+        list_splice(&(current->children), &(initproc->children));
+        if (!list_empty(&(current->zombies)))
         {
-            wakeup_proc(proc);
-        }
-        while (current->cptr != NULL)
-        {
-            proc = current->cptr;
-            current->cptr = proc->optr;
-
-            proc->yptr = NULL;
-            if ((proc->optr = initproc->cptr) != NULL)
-            {
-                initproc->cptr->yptr = proc;
-            }
-            proc->parent = initproc;
-            initproc->cptr = proc;
-            if (proc->state == PROC_ZOMBIE)
-            {
-                if (initproc->wait_state == WT_CHILD)
-                {
-                    wakeup_proc(initproc);
-                }
-            }
+            list_splice(&(current->zombies), &(initproc->zombies));
+            wakeup_all(&(initproc->wait_child), WT_CHILD, 1);
         }
     }
     local_intr_restore(intr_flag);
@@ -580,42 +655,80 @@ int do_exit(int error_code)
     panic("do_exit will not return!! %d.\n", current->pid);
 }
 
-/* load_icode - load the content of binary program(ELF format) as the new content of current process
- * @binary:  the memory addr of the content of binary program
- * @size:  the size of the content of binary program
+// do_exit_group - called by sys_exit_group, exits the whole thread group:
+//               - the other threads are killed and exit with -E_KILLED when
+//               - they next run, they are reaped like any other child
+int do_exit_group(int error_code)
+{
+    leave_thread_group(1);
+    return do_exit(error_code);
+}
+
+/* do_clone - create a thread, or a process, starting at fn(arg) on stack
+ * @clone_flags: CLONE_VM to share the mm, and CLONE_THREAD to join the thread
+ *               group of current as well, so the threads exit together
+ * @stack:       the user stack top of the new thread
+ * @fn:          the user address the new thread starts at, with arg in a0
+ * the new thread is a child of current, which joins it with do_wait
  */
-static int
-load_icode(unsigned char *binary, size_t size)
+int do_clone(uint32_t clone_flags, uintptr_t stack, uintptr_t fn, uintptr_t arg)
 {
-    if (current->mm != NULL)
+    if ((clone_flags & CLONE_VFORK) || ((clone_flags & CLONE_THREAD) && !(clone_flags & CLONE_VM)))
     {
-        panic("load_icode: current->mm must be empty.\n");
+        return -E_INVAL;
     }
-
-    int ret = -E_NO_MEM;
-    struct mm_struct *mm;
-    //(1) create a new mm for current process
-    if ((mm = mm_create()) == NULL)
+    if (current->mm == NULL || !USER_ACCESS(fn, fn + 1) || !USER_ACCESS(stack - 1, stack))
     {
-        goto bad_mm;
+        return -E_INVAL;
     }
-    //(2) create a new PDT, and mm->pgdir= kernel virtual addr of PDT
-    if (setup_pgdir(mm) != 0)
+    struct trapframe tf = *(current->tf);
+    tf.epc = fn;
+    int ret;
+    if ((ret = do_fork(clone_flags, stack, &tf)) > 0)
     {
-        goto bad_pgdir_cleanup_mm;
+        // copy_thread zeroes a0 for fork, the child has not run yet
+        find_proc(ret)->tf->gpr.a0 = arg;
     }
-    //(3) copy TEXT/DATA section, build BSS parts in binary to memory space of process
-    struct Page *page;
-    //(3.1) get the file header of the bianry program (ELF format)
+    return ret;
+}
+
+/* load_elf_mm - build the memory of a process running a binary program (ELF format)
+ * @binary:      the memory addr of the content of binary program
+ * @size:        the size of the content of binary program
+ * @mm_store:    an empty mm to load the program into, see mm_recycle, or NULL
+ *               for a new one, which is stored there with mm_count 0
+ * @entry_store: the entry point of the program
+ * an mm given is left to the caller to free if loading fails halfway
+ */
+int load_elf_mm(unsigned char *binary, size_t size, struct mm_struct **mm_store, uintptr_t *entry_store)
+{
+    int ret = -E_INVAL_ELF;
+    struct mm_struct *mm = *mm_store;
+    //(1) get the file header of the bianry program (ELF format)
     struct elfhdr *elf = (struct elfhdr *)binary;
-    //(3.2) get the entry of the program section headers of the bianry program (ELF format)
+    //(2) get the entry of the program section headers of the bianry program (ELF format)
     struct proghdr *ph = (struct proghdr *)(binary + elf->e_phoff);
-    //(3.3) This program is valid?
+    //(3) This program is valid?
     if (elf->e_magic != ELF_MAGIC)
     {
-        ret = -E_INVAL_ELF;
-        goto bad_elf_cleanup_pgdir;
+        goto bad_mm;
     }
+    ret = -E_NO_MEM;
+    if (mm == NULL)
+    {
+        //(3.1) create a new mm for current process
+        if ((mm = mm_create()) == NULL)
+        {
+            goto bad_mm;
+        }
+        //(3.2) create a new PDT, and mm->pgdir= kernel virtual addr of PDT
+        if (setup_pgdir(mm) != 0)
+        {
+            goto bad_pgdir_cleanup_mm;
+        }
+    }
+    //(3.3) copy TEXT/DATA section, build BSS parts in binary to memory space of process
+    struct Page *page;
 
     uint32_t vm_flags, perm;
     struct proghdr *ph_end = ph + elf->e_phnum;
@@ -647,7 +760,8 @@ load_icode(unsigned char *binary, size_t size)
         if (vm_flags & VM_WRITE) perm |= PTE_W;
         if (vm_flags & VM_EXEC) perm |= PTE_X;
         
-        cprintf("[DEBUG load_icode] ph->p_flags=0x%x, vm_flags=0x%x, perm=0x%x\n", ph->p_flags, vm_flags, perm);
+        trace(TRACE_INFO, TRACE_EXEC, "load_icode: va 0x%x, memsz 0x%x, vm_flags 0x%x, perm 0x%x\n",
+              ph->p_va, ph->p_memsz, vm_flags, perm);
 
         if ((ret = mm_map(mm, ph->p_va, ph->p_memsz, vm_flags, NULL)) != 0)
         {
@@ -664,7 +778,6 @@ load_icode(unsigned char *binary, size_t size)
         //(3.6.1) copy TEXT/DATA section of bianry program
         while (start < end)
         {
-            cprintf("[DEBUG load_icode] Calling pgdir_alloc_page with perm=0x%x\n", perm);
             if ((page = pgdir_alloc_page(mm->pgdir, la, perm)) == NULL)
             {
                 goto bad_cleanup_mmap;
@@ -696,40 +809,70 @@ load_icode(unsigned char *binary, size_t size)
             start += size;
             assert((end < la && start == end) || (end >= la && start == la));
         }
-        while (start < end)
-        {
-            if ((page = pgdir_alloc_page(mm->pgdir, la, perm)) == NULL)
-            {
-                goto bad_cleanup_mmap;
-            }
-            off = start - la, size = PGSIZE - off, la += PGSIZE;
-            if (end < la)
-            {
-                size -= la - end;
-            }
-            memset(page2kva(page) + off, 0, size);
-            start += size;
-        }
+        // the whole BSS pages in [la, end) are left unmapped: the vma covers them,
+        // so reads fault in the zero page and writes a fresh zeroed page
     }
     //(4) build user stack memory
+    //    only the top page is mapped now, the VM_STACK vma grows down on page
+    //    faults up to mm->stack_limit (see expand_stack)
     vm_flags = VM_READ | VM_WRITE | VM_STACK;
-    if ((ret = mm_map(mm, USTACKTOP - USTACKSIZE, USTACKSIZE, vm_flags, NULL)) != 0)
+    if ((ret = mm_map(mm, USTACKTOP - PGSIZE, PGSIZE, vm_flags, NULL)) != 0)
+    {
+        goto bad_cleanup_mmap;
+    }
+    ret = -E_NO_MEM;
+    if (pgdir_alloc_page(mm->pgdir, USTACKTOP - PGSIZE, PTE_U | PTE_R | PTE_W) == NULL)
     {
         goto bad_cleanup_mmap;
     }
-    assert(pgdir_alloc_page(mm->pgdir, USTACKTOP - PGSIZE, PTE_U | PTE_R | PTE_W) != NULL);
-    assert(pgdir_alloc_page(mm->pgdir, USTACKTOP - 2 * PGSIZE, PTE_U | PTE_R | PTE_W) != NULL);
-    assert(pgdir_alloc_page(mm->pgdir, USTACKTOP - 3 * PGSIZE, PTE_U | PTE_R | PTE_W) != NULL);
-    assert(pgdir_alloc_page(mm->pgdir, USTACKTOP - 4 * PGSIZE, PTE_U | PTE_R | PTE_W) != NULL);
 
-    //(5) set current process's mm, sr3, and set satp reg = physical addr of Page Directory
-    mm_count_inc(mm);
-    current->mm = mm;
-    current->pgdir = PADDR(mm->pgdir);
-    lsatp(PADDR(mm->pgdir));
+    *mm_store = mm, *entry_store = elf->e_entry;
+    ret = 0;
+out:
+    return ret;
+bad_cleanup_mmap:
+    if (*mm_store != NULL)
+    {
+        goto out;
+    }
+    exit_mmap(mm);
+    put_pgdir(mm);
+bad_pgdir_cleanup_mm:
+    mm_destroy(mm);
+bad_mm:
+    goto out;
+}
+
+/* load_icode - load the content of binary program(ELF format) as the new content of process proc
+ * @proc:    current for exec, or a new process not yet running for spawn. exec may
+ *           leave current its old mm, emptied by mm_recycle, to load the program into
+ * @file:    the program in the initrd, its mm is cloned from the exec template
+ */
+static int
+load_icode(struct proc_struct *proc, struct initrd_entry *file)
+{
+    struct mm_struct *mm = proc->mm;
+    uintptr_t entry;
+    int ret;
+    if ((ret = template_mm(file, &mm, &entry)) != 0)
+    {
+        return ret;
+    }
+
+    //(5) set proc's mm, sr3, and set satp reg = physical addr of Page Directory if proc is current
+    if (proc->mm == NULL)
+    {
+        mm_count_inc(mm);
+        proc->mm = mm;
+        proc->pgdir = PADDR(mm->pgdir);
+        if (proc == current)
+        {
+            lsatp(PADDR(mm->pgdir));
+        }
+    }
 
     //(6) setup trapframe for user environment
-    struct trapframe *tf = current->tf;
+    struct trapframe *tf = proc->tf;
     // Keep sstatus
     uintptr_t sstatus = tf->status;
     memset(tf, 0, sizeof(struct trapframe));
@@ -742,57 +885,76 @@ load_icode(unsigned char *binary, size_t size)
      *          hint: check meaning of SPP, SPIE in SSTATUS, use them by SSTATUS_SPP, SSTATUS_SPIE(defined in risv.h)
      */
     tf->gpr.sp = USTACKTOP;
-    tf->epc = elf->e_entry;
+    tf->epc = entry;
     tf->status = (sstatus & ~SSTATUS_SPP) | SSTATUS_SPIE;
-    ret = 0;
-out:
-    return ret;
-bad_cleanup_mmap:
-    exit_mmap(mm);
-bad_elf_cleanup_pgdir:
-    put_pgdir(mm);
-bad_pgdir_cleanup_mm:
-    mm_destroy(mm);
-bad_mm:
-    goto out;
+    return 0;
 }
 
-// do_execve - call exit_mmap(mm)&put_pgdir(mm) to reclaim memory space of current process
-//           - call load_icode to setup new memory space accroding binary prog.
-int do_execve(const char *name, size_t len, unsigned char *binary, size_t size)
+// find_program - the initrd file at the path of len bytes in the memory of current
+static int
+find_program(const char *path, size_t len, struct initrd_entry **entry_store)
 {
-    struct mm_struct *mm = current->mm;
-    if (!user_mem_check(mm, (uintptr_t)name, len, 0))
+    char local_path[INITRD_NAME_LEN + 1];
+    // copy_from_user takes no empty range, and no file has an empty name
+    if (len == 0 || len > INITRD_NAME_LEN)
     {
-        return -E_INVAL;
+        return -E_NOENT;
     }
-    if (len > PROC_NAME_LEN)
+    memset(local_path, 0, sizeof(local_path));
+    if (!copy_from_user(current->mm, local_path, path, len, 0))
     {
-        len = PROC_NAME_LEN;
+        return -E_FAULT;
     }
+    if ((*entry_store = initrd_lookup(local_path)) == NULL)
+    {
+        return -E_NOENT;
+    }
+    return 0;
+}
 
-    char local_name[PROC_NAME_LEN + 1];
-    memset(local_name, 0, sizeof(local_name));
-    memcpy(local_name, name, len);
+// do_execve - find the program at path in the initrd, call exit_mm(mm) to
+//           - reclaim memory space of current process, then call load_icode
+//           - to setup new memory space from the program in place in the initrd.
+//           - an mm nobody else uses is emptied by mm_recycle and loaded again
+int do_execve(const char *path, size_t len)
+{
+    struct mm_struct *mm = current->mm;
+    struct initrd_entry *entry;
+    int ret;
+    if ((ret = find_program(path, len, &entry)) != 0)
+    {
+        return ret;
+    }
 
-    if (mm != NULL)
+    bool recycle = (mm != NULL && exec_recycle && mm_count(mm) == 1);
+    if (mm != NULL && !recycle)
     {
         cputs("mm != NULL");
         lsatp(boot_pgdir_pa);
         if (mm_count_dec(mm) == 0)
         {
-            exit_mmap(mm);
-            put_pgdir(mm);
-            mm_destroy(mm);
+            exit_mm(mm);
         }
         current->mm = NULL;
     }
-    int ret;
-    if ((ret = load_icode(binary, size)) != 0)
+    vfork_release(current);
+    // the other threads ran on the old program, they go away with it
+    leave_thread_group(1);
+    if (recycle)
+    {
+        lock_mm(mm);
+        mm_recycle(mm);
+    }
+    ret = load_icode(current, entry);
+    if (recycle)
+    {
+        unlock_mm(mm);
+    }
+    if (ret != 0)
     {
         goto execve_exit;
     }
-    set_proc_name(current, local_name);
+    set_proc_name(current, entry->name);
     return 0;
 
 execve_exit:
@@ -800,6 +962,66 @@ execve_exit:
     panic("already exit: %e.\n", ret);
 }
 
+// do_spawn - create a child process running the program at path in the initrd, like
+//          - fork followed by exec in the child, but without ever copying the parent's mm
+// return value: the pid of the child
+int do_spawn(const char *path, size_t len)
+{
+    struct initrd_entry *entry;
+    int ret;
+    if ((ret = find_program(path, len, &entry)) != 0)
+    {
+        return ret;
+    }
+
+    ret = -E_NO_FREE_PROC;
+    struct proc_struct *proc;
+    if (nr_process >= MAX_PROCESS)
+    {
+        goto spawn_out;
+    }
+    ret = -E_NO_MEM;
+    if ((proc = alloc_proc()) == NULL)
+    {
+        goto spawn_out;
+    }
+    if ((proc->pid = alloc_pid()) < 0)
+    {
+        ret = proc->pid;
+        goto bad_spawn_cleanup_proc;
+    }
+    proc->parent = current;
+    current->wait_state = 0;
+
+    if (setup_kstack(proc) != 0)
+    {
+        goto bad_spawn_cleanup_pid;
+    }
+    copy_thread(proc, 0, current->tf);
+    if ((ret = load_icode(proc, entry)) != 0)
+    {
+        goto bad_spawn_cleanup_kstack;
+    }
+    set_proc_name(proc, entry->name);
+
+    hash_proc(proc);
+    set_links(proc);
+
+    wakeup_proc(proc);
+    ret = proc->pid;
+
+spawn_out:
+    return ret;
+
+bad_spawn_cleanup_kstack:
+    put_kstack(proc);
+bad_spawn_cleanup_pid:
+    free_pid(proc->pid);
+bad_spawn_cleanup_proc:
+    kfree(proc);
+    goto spawn_out;
+}
+
 // do_yield - ask the scheduler to reschedule
 int do_yield(void)
 {
@@ -807,6 +1029,17 @@ int do_yield(void)
     return 0;
 }
 
+// do_setpriority - set the share of the cpu current gets, from 1 to MAX_PRIORITY
+int do_setpriority(uint32_t priority)
+{
+    if (priority == 0 || priority > MAX_PRIORITY)
+    {
+        return -E_INVAL;
+    }
+    current->priority = priority;
+    return 0;
+}
+
 // do_wait - wait one OR any children with PROC_ZOMBIE state, and free memory space of kernel stack
 //         - proc struct of this child.
 // NOTE: only after do_wait function, all resources of the child proces are free.
@@ -815,7 +1048,7 @@ int do_wait(int pid, int *code_store)
     struct mm_struct *mm = current->mm;
     if (code_store != NULL)
     {
-        if (!user_mem_check(mm, (uintptr_t)code_store, sizeof(int), 1))
+        if (mm != NULL && !USER_ACCESS((uintptr_t)code_store, (uintptr_t)(code_store + 1)))
         {
             return -E_INVAL;
         }
@@ -828,7 +1061,7 @@ repeat:
     if (pid != 0)
     {
         proc = find_proc(pid);
-        if (proc != NULL && proc->parent == current)
+        if (proc != NULL && proc_parent(proc) == current)
         {
             haskid = 1;
             if (proc->state == PROC_ZOMBIE)
@@ -837,23 +1070,27 @@ repeat:
             }
         }
     }
+    else if (!list_empty(&(current->zombies)))
+    {
+        proc = le2proc(list_next(&(current->zombies)), child_link);
+        goto found;
+    }
     else
     {
-        proc = current->cptr;
-        for (; proc != NULL; proc = proc->optr)
-        {
-            haskid = 1;
-            if (proc->state == PROC_ZOMBIE)
-            {
-                goto found;
-            }
-        }
+        haskid = !list_empty(&(current->children));
     }
     if (haskid)
     {
-        current->state = PROC_SLEEPING;
-        current->wait_state = WT_CHILD;
+        wait_t __wait, *wait = &__wait;
+        local_intr_save(intr_flag);
+        wait_current_set(&(current->wait_child), wait, WT_CHILD);
+        local_intr_restore(intr_flag);
+
         schedule();
+
+        local_intr_save(intr_flag);
+        wait_current_del(&(current->wait_child), wait);
+        local_intr_restore(intr_flag);
         if (current->flags & PF_EXITING)
         {
             do_exit(-E_KILLED);
@@ -867,9 +1104,13 @@ found:
     {
         panic("wait idleproc or initproc.\n");
     }
+    // store the exit code before reaping, so a bad pointer leaves the child waitable
     if (code_store != NULL)
     {
-        *code_store = proc->exit_code;
+        if (!copy_to_user(mm, code_store, &(proc->exit_code), sizeof(int)))
+        {
+            return -E_FAULT;
+        }
     }
     local_intr_save(intr_flag);
     {
@@ -878,78 +1119,211 @@ found:
     }
     local_intr_restore(intr_flag);
     put_kstack(proc);
-    kfree(proc);
+    put_proc(proc);
     return 0;
 }
 
-// do_kill - kill process with pid by set this process's flags with PF_EXITING
+// do_kill - kill process with pid by set this process's flags with PF_EXITING,
+//         - and the other threads of its thread group with it
 int do_kill(int pid)
 {
     struct proc_struct *proc;
     if ((proc = find_proc(pid)) != NULL)
     {
-        if (!(proc->flags & PF_EXITING))
+        int ret;
+        bool intr_flag;
+        local_intr_save(intr_flag);
         {
-            proc->flags |= PF_EXITING;
-            if (proc->wait_state & WT_INTERRUPTED)
+            if ((ret = kill_proc(proc)) == 0)
             {
-                wakeup_proc(proc);
+                kill_threads(proc);
             }
-            return 0;
         }
-        return -E_KILLED;
+        local_intr_restore(intr_flag);
+        return ret;
     }
     return -E_INVAL;
 }
 
-// kernel_execve - do SYS_exec syscall to exec a user program called by user_main kernel_thread
+// do_sleep - put current process to sleep for time clock ticks
+int do_sleep(unsigned int time)
+{
+    if (time == 0)
+    {
+        return 0;
+    }
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    timer_t __timer, *timer = timer_init(&__timer, current, time);
+    current->state = PROC_SLEEPING;
+    current->wait_state = WT_TIMER;
+    add_timer(timer);
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    del_timer(timer);
+    return 0;
+}
+
+// do_mmap - map len bytes of zeroed anonymous memory into current process
+//         - *addr_store is the hint address on entry (0 to let the kernel choose),
+//         - and the address of the new mapping on return.
+//         - with MMAP_SHARED the pages are allocated up front and stay shared
+//         - with every child forked afterwards instead of becoming copy-on-write
+int do_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags)
+{
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL)
+    {
+        panic("kernel thread call mmap!!.\n");
+    }
+    if (addr_store == NULL || len == 0)
+    {
+        return -E_INVAL;
+    }
+
+    int ret = -E_INVAL;
+
+    uintptr_t addr;
+
+    lock_mm(mm);
+    if (!copy_from_user(mm, &addr, addr_store, sizeof(uintptr_t), 1))
+    {
+        goto out_unlock;
+    }
+
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    addr = start, len = end - start;
+
+    uint32_t vm_flags = VM_READ;
+    if (mmap_flags & MMAP_WRITE)
+        vm_flags |= VM_WRITE;
+    if (mmap_flags & MMAP_SHARED)
+        vm_flags |= VM_SHARED;
+
+    ret = -E_NO_MEM;
+    if (addr == 0)
+    {
+        if ((addr = get_unmapped_area(mm, len)) == 0)
+        {
+            goto out_unlock;
+        }
+    }
+    if ((ret = mm_map(mm, addr, len, vm_flags, NULL)) != 0)
+    {
+        goto out_unlock;
+    }
+    if ((vm_flags & VM_SHARED) && (ret = mm_populate(mm, addr, addr + len)) != 0)
+    {
+        goto out_unmap;
+    }
+    if (!copy_to_user(mm, addr_store, &addr, sizeof(uintptr_t)))
+    {
+        ret = -E_FAULT;
+        goto out_unmap;
+    }
+    ret = 0;
+
+out_unlock:
+    unlock_mm(mm);
+    return ret;
+out_unmap:
+    mm_unmap(mm, addr, len);
+    goto out_unlock;
+}
+
+// do_munmap - remove the mappings of [addr, addr + len) from current process
+int do_munmap(uintptr_t addr, size_t len)
+{
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL)
+    {
+        panic("kernel thread call munmap!!.\n");
+    }
+    if (len == 0)
+    {
+        return -E_INVAL;
+    }
+    int ret;
+    lock_mm(mm);
+    {
+        ret = mm_unmap(mm, addr, len);
+    }
+    unlock_mm(mm);
+    return ret;
+}
+
+// do_madvise - tune the fault-around of [addr, addr + len) in current process
+int do_madvise(uintptr_t addr, size_t len, int advice)
+{
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL)
+    {
+        panic("kernel thread call madvise!!.\n");
+    }
+    size_t pages;
+    switch (advice)
+    {
+    case MADV_NORMAL:
+        pages = FAULT_AROUND_DEFAULT;
+        break;
+    case MADV_RANDOM:
+        pages = 1;
+        break;
+    case MADV_SEQUENTIAL:
+        pages = FAULT_AROUND_MAX;
+        break;
+    default:
+        return -E_INVAL;
+    }
+    int ret;
+    lock_mm(mm);
+    {
+        ret = mm_fault_around(mm, addr, len, pages);
+    }
+    unlock_mm(mm);
+    return ret;
+}
+
+// kernel_execve - do SYS_exec syscall to exec the user program at path in the
+//               - initrd, called by user_main kernel_thread
 static int
-kernel_execve(const char *name, unsigned char *binary, size_t size)
+kernel_execve(const char *path)
 {
-    int64_t ret = 0, len = strlen(name);
-    //   ret = do_execve(name, len, binary, size);
+    int64_t ret = 0, len = strlen(path);
+    //   ret = do_execve(path, len);
     asm volatile(
         "li a0, %1\n"
-        "lw a1, %2\n"
-        "lw a2, %3\n"
-        "lw a3, %4\n"
-        "lw a4, %5\n"
+        "ld a1, %2\n"
+        "ld a2, %3\n"
         "li a7, 10\n"
         "ebreak\n"
         "sw a0, %0\n"
         : "=m"(ret)
-        : "i"(SYS_exec), "m"(name), "m"(len), "m"(binary), "m"(size)
+        : "i"(SYS_exec), "m"(path), "m"(len)
         : "memory");
     cprintf("ret = %d\n", ret);
     return ret;
 }
 
-#define __KERNEL_EXECVE(name, binary, size) ({           \
+#define __KERNEL_EXECVE(name) ({                         \
     cprintf("kernel_execve: pid = %d, name = \"%s\".\n", \
             current->pid, name);                         \
-    kernel_execve(name, binary, (size_t)(size));         \
-})
-
-#define KERNEL_EXECVE(x) ({                                    \
-    extern unsigned char _binary_obj___user_##x##_out_start[], \
-        _binary_obj___user_##x##_out_size[];                   \
-    __KERNEL_EXECVE(#x, _binary_obj___user_##x##_out_start,    \
-                    _binary_obj___user_##x##_out_size);        \
+    kernel_execve(name);                                 \
 })
 
-#define __KERNEL_EXECVE2(x, xstart, xsize) ({   \
-    extern unsigned char xstart[], xsize[];     \
-    __KERNEL_EXECVE(#x, xstart, (size_t)xsize); \
-})
+#define KERNEL_EXECVE(x) __KERNEL_EXECVE(#x)
 
-#define KERNEL_EXECVE2(x, xstart, xsize) __KERNEL_EXECVE2(x, xstart, xsize)
+// KERNEL_EXECVE2 - KERNEL_EXECVE of a macro, e.g. TEST from make build-<prog>
+#define KERNEL_EXECVE2(x) KERNEL_EXECVE(x)
 
 // user_main - kernel thread used to exec a user program
 static int
 user_main(void *arg)
 {
 #ifdef TEST
-    KERNEL_EXECVE2(TEST, TESTSTART, TESTSIZE);
+    KERNEL_EXECVE2(TEST);
 #else
     // KERNEL_EXECVE(exit);
     KERNEL_EXECVE(cow_test);
@@ -970,13 +1344,27 @@ init_main(void *arg)
         panic("create user_main failed.\n");
     }
 
+    if (ksm_start() <= 0)
+    {
+        panic("create ksmd failed.\n");
+    }
+    if (workqueue_start() != 0)
+    {
+        panic("create workqueue workers failed.\n");
+    }
+
+    // ksmd and the workers run until user_main is gone, then they and the
+    // orphans it left are reaped
+    do_wait(pid, NULL);
+    ksm_stop();
+    workqueue_stop();
     while (do_wait(0, NULL) == 0)
     {
         schedule();
     }
 
     cprintf("all user-mode processes have quit.\n");
-    assert(initproc->cptr == NULL && initproc->yptr == NULL && initproc->optr == NULL);
+    assert(list_empty(&(initproc->children)) && list_empty(&(initproc->zombies)));
     assert(nr_process == 2);
     assert(list_next(&proc_list) == &(initproc->list_link));
     assert(list_prev(&proc_list) == &(initproc->list_link));
@@ -989,13 +1377,11 @@ init_main(void *arg)
 //           - create the second kernel thread init_main
 void proc_init(void)
 {
-    int i;
-
     list_init(&proc_list);
-    for (i = 0; i < HASH_LIST_SIZE; i++)
-    {
-        list_init(hash_list + i);
-    }
+    pid_init();
+    kstack_init();
+    workqueue_init();
+    mm_reap_init();
 
     if ((idleproc = alloc_proc()) == NULL)
     {
@@ -1010,6 +1396,8 @@ void proc_init(void)
     nr_process++;
 
     current = idleproc;
+    check_mutex();
+    template_init();
 
     int pid = kernel_thread(init_main, NULL, 0);
     if (pid <= 0)
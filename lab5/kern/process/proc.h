@@ -3,8 +3,11 @@
 
 #include <defs.h>
 #include <list.h>
+#include <skew_heap.h>
+#include <rbtree.h>
 #include <trap.h>
 #include <memlayout.h>
+#include <wait.h>
 
 // process's state in his life cycle
 enum proc_state
@@ -34,11 +37,20 @@ struct context
 };
 
 #define PROC_NAME_LEN 15
-#define MAX_PROCESS 4096
-#define MAX_PID (MAX_PROCESS * 2)
+#define MAX_PROCESS 32768 // pids are also bounded by pid_max, see pid.h
+
+// exec reuses the mm of the old program, with its PDT and PTs, when no other
+// process or thread shares it, instead of freeing it and building a new one
+#ifndef EXEC_RECYCLE
+#define EXEC_RECYCLE 1
+#endif
+
+extern bool exec_recycle;
 
 extern list_entry_t proc_list;
 
+struct run_queue;
+
 struct proc_struct
 {
     enum proc_state state;                  // Process state
@@ -54,13 +66,36 @@ struct proc_struct
     uint32_t flags;                         // Process flag
     char name[PROC_NAME_LEN + 1];           // Process name
     list_entry_t list_link;                 // Process link list
-    list_entry_t hash_link;                 // Process hash list
     int exit_code;                          // exit code (be sent to parent proc)
     uint32_t wait_state;                    // waiting state
-    struct proc_struct *cptr, *yptr, *optr; // relations between processes
+    list_entry_t children;                  // the children still running
+    list_entry_t zombies;                   // the exited children, in exit order
+    list_entry_t child_link;                // link in the children or zombies of the parent
+    int refs;                               // 1 until reaped, +1 per child pointing here
+    wait_queue_t wait_child;                // do_wait sleeps here until a child exits
+    wait_queue_t vfork_done;                // a vfork parent sleeps here until proc execs or exits
+    list_entry_t thread_group;              // the other threads sharing this mm, see do_clone
+    struct run_queue *rq;                   // the run queue proc waits on to run, NULL if none
+    list_entry_t run_link;                  // the entry linked in the run queue
+    int time_slice;                         // ticks left before the cpu goes to another process
+    skew_heap_entry_t run_pool;             // the entry in the run pool of the stride scheduler
+    uint32_t pass;                          // the pass of the stride scheduler, the least runs next
+    uint32_t priority;                      // the cpu share, as stride or weight, see setpriority
+    struct rb_node run_node;                // the node in the tree of the fair scheduler
+    uint64_t vruntime;                      // the ns run, divided by priority, for the fair scheduler
+    uint64_t exec_start;                    // when the run time was last charged, in ns
+    uint64_t slice_start;                   // when the process was picked to run, in ns
+    int mlfq_level;                         // the queue of the mlfq scheduler, 0 runs first
 };
 
 #define PF_EXITING 0x00000001 // getting shutdown
+#define PF_VFORK 0x00000002   // vfork child still borrowing its parent's mm
+
+#define WT_VFORK 0x00000002                   // wait for a vfork child to exec or exit
+#define WT_TIMER (0x00000004 | WT_INTERRUPTED) // wait timer
+#define WT_MUTEX 0x00000008                    // wait for a mutex_t
+#define WT_SEM 0x00000010                      // wait for a semaphore_t
+#define WT_WORK 0x00000020                     // wait for works to run or to be done
 
 #define WT_CHILD (0x00000001 | WT_INTERRUPTED)
 #define WT_INTERRUPTED 0x80000000 // the wait state could be interrupted
@@ -81,8 +116,18 @@ void cpu_idle(void) __attribute__((noreturn));
 struct proc_struct *find_proc(int pid);
 int do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf);
 int do_exit(int error_code);
+int do_exit_group(int error_code);
+int do_clone(uint32_t clone_flags, uintptr_t stack, uintptr_t fn, uintptr_t arg);
 int do_yield(void);
-int do_execve(const char *name, size_t len, unsigned char *binary, size_t size);
+int load_elf_mm(unsigned char *binary, size_t size, struct mm_struct **mm_store, uintptr_t *entry_store);
+struct mm_struct *dup_mm(struct mm_struct *oldmm);
+int do_execve(const char *path, size_t len);
+int do_spawn(const char *path, size_t len);
 int do_wait(int pid, int *code_store);
 int do_kill(int pid);
+int do_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
+int do_munmap(uintptr_t addr, size_t len);
+int do_madvise(uintptr_t addr, size_t len, int advice);
+int do_sleep(unsigned int time);
+int do_setpriority(uint32_t priority);
 #endif /* !__KERN_PROCESS_PROC_H__ */
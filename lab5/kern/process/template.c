@@ -0,0 +1,293 @@
+#include <defs.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <error.h>
+#include <kmalloc.h>
+#include <pmm.h>
+#include <vmm.h>
+#include <proc.h>
+#include <initrd.h>
+#include <template.h>
+
+/* *
+ * Exec templates. Building the memory of a process, mm_create, setup_pgdir
+ * and the ELF segments of load_elf_mm, is the same work every time a given
+ * program starts. The first exec of a program keeps the mm it built as a
+ * "golden" template nobody runs, and every exec of the program, the first
+ * one too, gets a clone of it by dup_mm, as fork would: the page tables
+ * are shared and the pages copy-on-write, so the template itself stays as
+ * loaded. Templates are dropped least recently used first, to make room
+ * for a new one or when alloc_pages runs out of memory.
+ * */
+
+struct template
+{
+    struct initrd_entry *file;  // the program
+    struct mm_struct *mm;       // the golden mm, with mm_count 1 for the cache
+    uintptr_t entry;            // the entry point of the program
+    size_t hits;                // execs that cloned it
+    int busy;                   // clones being made, the shrinker leaves it alone
+    list_entry_t template_link; // in template_list, most recently used first
+};
+
+#define le2template(le, member) \
+    to_struct((le), struct template, member)
+
+bool template_enable = EXEC_TEMPLATES;
+struct template_stats template_stats;
+
+static list_entry_t template_list = {&template_list, &template_list};
+static int nr_templates;
+
+static size_t template_shrink(size_t nr_pages);
+
+static struct shrinker template_shrinker = {
+    .name = "template",
+    .shrink = template_shrink,
+};
+
+static void check_template(void);
+
+// template_find - the template of file, made the most recently used one
+static struct template *
+template_find(struct initrd_entry *file)
+{
+    list_entry_t *le = &template_list;
+    while ((le = list_next(le)) != &template_list)
+    {
+        struct template *t = le2template(le, template_link);
+        if (t->file == file)
+        {
+            list_del(le);
+            list_add(&template_list, le);
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// template_evict - drop a template, its golden mm goes, its pages stay
+//                - as long as clones map them
+static void
+template_evict(struct template *t)
+{
+    assert(t->busy == 0);
+    list_del(&(t->template_link));
+    nr_templates--;
+    mm_count_dec(t->mm);
+    mm_reap(t->mm, 0);
+    kfree(t);
+    template_stats.evicted++;
+}
+
+// template_lru - the least recently used template not being cloned, NULL if none
+static struct template *
+template_lru(void)
+{
+    list_entry_t *le = &template_list;
+    while ((le = list_prev(le)) != &template_list)
+    {
+        struct template *t = le2template(le, template_link);
+        if (t->busy == 0)
+        {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// template_insert - keep the mm just built for file as its template
+static struct template *
+template_insert(struct initrd_entry *file, struct mm_struct *mm, uintptr_t entry)
+{
+    struct template *t;
+    if ((t = kmalloc(sizeof(struct template))) == NULL)
+    {
+        return NULL;
+    }
+    struct template *lru;
+    if (nr_templates >= TEMPLATE_MAX && (lru = template_lru()) != NULL)
+    {
+        template_evict(lru);
+    }
+    t->file = file, t->mm = mm, t->entry = entry;
+    t->hits = 0, t->busy = 0;
+    mm_count_inc(mm);
+    list_add(&template_list, &(t->template_link));
+    nr_templates++;
+    return t;
+}
+
+// template_mm - an mm running file, cloned from its template, which is
+//             - built first if there is none
+// @mm_store:    an empty mm to clone into, see mm_recycle, or NULL for a new
+//               one, which is stored there with mm_count 0
+// @entry_store: the entry point of the program
+// an mm given is left to the caller to free if cloning fails halfway
+int template_mm(struct initrd_entry *file, struct mm_struct **mm_store, uintptr_t *entry_store)
+{
+    struct template *t = NULL;
+    int ret;
+    if (template_enable && (t = template_find(file)) != NULL)
+    {
+        template_stats.hits++, t->hits++;
+    }
+    else
+    {
+        struct mm_struct *mm = NULL;
+        uintptr_t entry;
+        if (!template_enable)
+        {
+            template_stats.bypassed++;
+            return load_elf_mm(initrd_data(file), file->size, mm_store, entry_store);
+        }
+        if ((ret = load_elf_mm(initrd_data(file), file->size, &mm, &entry)) != 0)
+        {
+            return ret;
+        }
+        if ((t = template_insert(file, mm, entry)) == NULL)
+        {
+            // no template then, the process gets the mm just built, or
+            // the program loaded into its own once more
+            template_stats.bypassed++;
+            if (*mm_store == NULL)
+            {
+                *mm_store = mm, *entry_store = entry;
+                return 0;
+            }
+            mm_reap(mm, 0);
+            return load_elf_mm(initrd_data(file), file->size, mm_store, entry_store);
+        }
+        template_stats.misses++;
+    }
+
+    struct mm_struct *mm = *mm_store;
+    t->busy++;
+    if (mm == NULL)
+    {
+        ret = ((mm = dup_mm(t->mm)) != NULL) ? 0 : -E_NO_MEM;
+    }
+    else
+    {
+        lock_mm(t->mm);
+        ret = dup_mmap(mm, t->mm);
+        unlock_mm(t->mm);
+    }
+    t->busy--;
+    if (ret != 0)
+    {
+        return ret;
+    }
+    *mm_store = mm, *entry_store = t->entry;
+    return 0;
+}
+
+// template_shrink - the shrinker: drop templates, least recently used
+//                 - first, until nr_pages pages come back or none is left
+static size_t
+template_shrink(size_t nr_pages)
+{
+    size_t freed = 0;
+    struct template *t;
+    while (freed < nr_pages && (t = template_lru()) != NULL)
+    {
+        size_t nr_free_pages_store = nr_free_pages();
+        template_evict(t);
+        freed += nr_free_pages() - nr_free_pages_store;
+    }
+    template_stats.shrunk += freed;
+    return freed;
+}
+
+// template_flush - drop every template not being cloned
+void template_flush(void)
+{
+    struct template *t;
+    while ((t = template_lru()) != NULL)
+    {
+        template_evict(t);
+    }
+}
+
+void print_template_stats(void)
+{
+    struct template_stats *stats = &template_stats;
+    size_t execs = stats->hits + stats->misses;
+    cprintf("templates: %s, %d of %d kept, %llu hits (%llu%%), %llu misses, %llu bypassed\n",
+            template_enable ? "on" : "off", nr_templates, TEMPLATE_MAX, stats->hits,
+            execs == 0 ? 0 : stats->hits * 100 / execs, stats->misses, stats->bypassed);
+    cprintf("templates: %llu evicted, %llu pages shrunk\n", stats->evicted, stats->shrunk);
+    list_entry_t *le = &template_list;
+    while ((le = list_next(le)) != &template_list)
+    {
+        struct template *t = le2template(le, template_link);
+        cprintf("  %-16s %llu hits\n", t->file->name, t->hits);
+    }
+}
+
+// template_init - let alloc_pages drop templates when it runs out of memory
+void template_init(void)
+{
+    register_shrinker(&template_shrinker);
+    check_template();
+}
+
+// check_template - run by idleproc, lock_mm in dup_mm needs a current
+static void
+check_template(void)
+{
+    struct initrd_entry *file = initrd_lookup("hello");
+    struct template_stats old = template_stats;
+    struct mm_struct *mm[2];
+    uintptr_t entry[2];
+    bool enable_store = template_enable;
+    int i;
+    assert(file != NULL && nr_templates == 0);
+
+    // the first exec builds the template, both get a clone of it
+    template_enable = 1;
+    for (i = 0; i < 2; i++)
+    {
+        mm[i] = NULL;
+        assert(template_mm(file, &mm[i], &entry[i]) == 0 && mm_count(mm[i]) == 0);
+    }
+    assert(template_stats.misses == old.misses + 1 && template_stats.hits == old.hits + 1);
+    assert(nr_templates == 1 && entry[0] == entry[1]);
+    struct template *t = le2template(list_next(&template_list), template_link);
+    assert(t->file == file && t->hits == 1 && t->mm != mm[0] && t->mm != mm[1]);
+
+    // an mm emptied by mm_recycle takes a clone again, its PDT kept and its
+    // private PTs making room for the shared ones of the template
+    pde_t *pgdir = mm[0]->pgdir;
+    assert(get_pte(pgdir, USTACKTOP - PGSIZE, 1) != NULL);
+    set_mm_count(mm[0], 1);
+    mm_recycle(mm[0]);
+    set_mm_count(mm[0], 0);
+    assert(mm[0]->map_count == 0 && get_page(pgdir, USTACKTOP - PGSIZE, NULL) == NULL);
+    assert(template_mm(file, &mm[0], &entry[0]) == 0 && mm[0]->pgdir == pgdir);
+    assert(entry[0] == entry[1] && t->hits == 2);
+
+    // the clones map the pages of the template, copy-on-write
+    pte_t *ptep = get_pte(t->mm->pgdir, entry[0], 0);
+    assert(ptep != NULL && (*ptep & PTE_V) && !(*ptep & PTE_W));
+    for (i = 0; i < 2; i++)
+    {
+        assert(get_page(mm[i]->pgdir, entry[0], NULL) == pte2page(*ptep));
+        mm_reap(mm[i], 0);
+    }
+
+    // with templates off an exec builds its own mm
+    template_enable = 0;
+    mm[0] = NULL;
+    assert(template_mm(file, &mm[0], &entry[0]) == 0 && template_stats.bypassed == old.bypassed + 1);
+    assert(nr_templates == 1 && entry[0] == entry[1]);
+    mm_reap(mm[0], 0);
+
+    // and the shrinker drops templates when memory runs out
+    assert(shrink_caches(1) > 0 && nr_templates == 0);
+    assert(template_stats.evicted == old.evicted + 1 && template_stats.shrunk > old.shrunk);
+
+    template_enable = enable_store;
+    cprintf("check_template() succeeded!\n");
+}
@@ -0,0 +1,34 @@
+#ifndef __KERN_PROCESS_TEMPLATE_H__
+#define __KERN_PROCESS_TEMPLATE_H__
+
+#include <defs.h>
+
+struct mm_struct;
+struct initrd_entry;
+
+// exec builds the mm of a program once, as a template, and gives every
+// process running it a copy-on-write clone. off with EXEC_TEMPLATES=0
+#ifndef EXEC_TEMPLATES
+#define EXEC_TEMPLATES 1
+#endif
+
+#define TEMPLATE_MAX 8 // templates kept, the least recently used one goes first
+
+struct template_stats
+{
+    size_t hits;     // execs cloning a template
+    size_t misses;   // execs building a new template
+    size_t bypassed; // execs building an mm of their own, templates off or no memory
+    size_t evicted;  // templates dropped, for a newer one or by the shrinker
+    size_t shrunk;   // pages the shrinker got back
+};
+
+extern bool template_enable;
+extern struct template_stats template_stats;
+
+void template_init(void);
+int template_mm(struct initrd_entry *file, struct mm_struct **mm_store, uintptr_t *entry_store);
+void template_flush(void);
+void print_template_stats(void);
+
+#endif /* !__KERN_PROCESS_TEMPLATE_H__ */
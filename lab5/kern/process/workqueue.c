@@ -0,0 +1,353 @@
+#include <defs.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sync.h>
+#include <kmalloc.h>
+#include <clock.h>
+#include <proc.h>
+#include <sched.h>
+#include <workqueue.h>
+
+/* *
+ * Workqueues. Work that need not be done right away, or cannot be done
+ * where it comes up, e.g. in an interrupt handler, is put in a work_struct
+ * and queued with queue_work, which only links it in with interrupts off
+ * and wakes an idle worker up. Each workqueue has a pool of worker kernel
+ * threads taking the works in queueing order.
+ *
+ * The workers are started by initproc with workqueue_start, after the
+ * first user process, so works queued before that wait for them, unless
+ * flush_workqueue finds no worker and runs them itself.
+ * */
+
+static list_entry_t wq_list = {&wq_list, &wq_list};
+static bool workers_started;
+
+struct workqueue *system_wq;
+
+static void check_workqueue(void);
+
+// dequeue_work - take the oldest work of wq off the queue to run it, with
+//              - interrupts off
+static struct work_struct *
+dequeue_work(struct workqueue *wq)
+{
+    struct work_struct *work = le2work(list_next(&(wq->works)), work_link);
+    list_del_init(&(work->work_link));
+    work->pending = 0;
+    wq->depth--, wq->running++;
+
+    size_t latency = ticks - work->queued_at;
+    wq->stats.latency += latency;
+    if (wq->stats.max_latency < latency)
+    {
+        wq->stats.max_latency = latency;
+    }
+    return work;
+}
+
+// run_work - run a work from dequeue_work, wake flushers up once the queue is done
+static void
+run_work(struct workqueue *wq, struct work_struct *work)
+{
+    work->func(work);
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        wq->running--, wq->stats.done++;
+        if (wq->depth == 0 && wq->running == 0)
+        {
+            wakeup_all(&(wq->flush_queue), WT_WORK, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+// worker_thread - run the works of wq, sleep while there are none, exit
+//               - once wq is exiting and empty
+static int
+worker_thread(void *arg)
+{
+    struct workqueue *wq = arg;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    while (1)
+    {
+        if (!list_empty(&(wq->works)))
+        {
+            struct work_struct *work = dequeue_work(wq);
+            local_intr_restore(intr_flag);
+            run_work(wq, work);
+            local_intr_save(intr_flag);
+        }
+        else if (wq->exiting)
+        {
+            break;
+        }
+        else
+        {
+            wait_t __wait, *wait = &__wait;
+            wait_current_set_exclusive(&(wq->idle_queue), wait, WT_WORK);
+            local_intr_restore(intr_flag);
+
+            schedule();
+
+            local_intr_save(intr_flag);
+            wait_current_del(&(wq->idle_queue), wait);
+        }
+    }
+    wq->nr_workers--;
+    wakeup_all(&(wq->flush_queue), WT_WORK, 1);
+    local_intr_restore(intr_flag);
+    return 0;
+}
+
+// start_workers - create the worker threads of wq, children of current
+static int
+start_workers(struct workqueue *wq)
+{
+    char name[PROC_NAME_LEN + 1];
+    while (wq->nr_workers < wq->max_workers)
+    {
+        int pid;
+        if ((pid = kernel_thread(worker_thread, wq, 0)) <= 0)
+        {
+            return pid;
+        }
+        snprintf(name, sizeof(name), "%s/%d", wq->name, wq->nr_workers);
+        set_proc_name(find_proc(pid), name);
+        wq->nr_workers++;
+    }
+    return 0;
+}
+
+// wake_workers - wake up every idle worker of wq
+static void
+wake_workers(struct workqueue *wq)
+{
+    while (!wait_queue_empty(&(wq->idle_queue)))
+    {
+        wakeup_first(&(wq->idle_queue), WT_WORK, 1);
+    }
+}
+
+// create_workqueue - a workqueue run by nr_workers threads, started now if
+//                  - the workers of the others are already
+struct workqueue *
+create_workqueue(const char *name, int nr_workers)
+{
+    struct workqueue *wq;
+    if (nr_workers < 1 || nr_workers > WQ_MAX_WORKERS || (wq = kmalloc(sizeof(struct workqueue))) == NULL)
+    {
+        return NULL;
+    }
+    memset(wq, 0, sizeof(struct workqueue));
+    strncpy(wq->name, name, WQ_NAME_LEN);
+    list_init(&(wq->works));
+    wq->max_workers = nr_workers;
+    wait_queue_init(&(wq->idle_queue));
+    wait_queue_init(&(wq->flush_queue));
+    list_add_before(&wq_list, &(wq->wq_link));
+    if (workers_started && start_workers(wq) != 0 && wq->nr_workers == 0)
+    {
+        list_del(&(wq->wq_link));
+        kfree(wq);
+        return NULL;
+    }
+    return wq;
+}
+
+// destroy_workqueue - run the works left, stop the workers and free wq
+void destroy_workqueue(struct workqueue *wq)
+{
+    flush_workqueue(wq);
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    wq->exiting = 1;
+    wake_workers(wq);
+    while (wq->nr_workers > 0)
+    {
+        wait_t __wait, *wait = &__wait;
+        wait_current_set(&(wq->flush_queue), wait, WT_WORK);
+        local_intr_restore(intr_flag);
+
+        schedule();
+
+        local_intr_save(intr_flag);
+        wait_current_del(&(wq->flush_queue), wait);
+    }
+    list_del(&(wq->wq_link));
+    local_intr_restore(intr_flag);
+    kfree(wq);
+}
+
+// queue_work - queue work on wq to run in a worker thread, from any context
+//            - interrupt handlers included
+// return value: 0 if work was pending already, 1 if it is queued now
+bool queue_work(struct workqueue *wq, struct work_struct *work)
+{
+    bool intr_flag, ret = 0;
+    local_intr_save(intr_flag);
+    if (!work->pending)
+    {
+        work->pending = 1, work->queued_at = ticks;
+        list_add_before(&(wq->works), &(work->work_link));
+        wq->stats.queued++;
+        if (++wq->depth > wq->stats.max_depth)
+        {
+            wq->stats.max_depth = wq->depth;
+        }
+        wakeup_first(&(wq->idle_queue), WT_WORK, 1);
+        ret = 1;
+    }
+    local_intr_restore(intr_flag);
+    return ret;
+}
+
+// flush_workqueue - wait until the works queued on wq are all done, running
+//                 - them here if wq has no workers
+void flush_workqueue(struct workqueue *wq)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    while (wq->depth > 0 || wq->running > 0)
+    {
+        if (wq->nr_workers == 0 && wq->depth > 0)
+        {
+            struct work_struct *work = dequeue_work(wq);
+            local_intr_restore(intr_flag);
+            run_work(wq, work);
+            local_intr_save(intr_flag);
+            continue;
+        }
+        wait_t __wait, *wait = &__wait;
+        wait_current_set(&(wq->flush_queue), wait, WT_WORK);
+        local_intr_restore(intr_flag);
+
+        schedule();
+
+        local_intr_save(intr_flag);
+        wait_current_del(&(wq->flush_queue), wait);
+    }
+    local_intr_restore(intr_flag);
+}
+
+// workqueue_start - create the worker threads of every workqueue, run by initproc
+int workqueue_start(void)
+{
+    int ret;
+    workers_started = 1;
+    list_entry_t *le = &wq_list;
+    while ((le = list_next(le)) != &wq_list)
+    {
+        if ((ret = start_workers(to_struct(le, struct workqueue, wq_link))) != 0)
+        {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+// workqueue_stop - let all workers exit once their queues are empty, their
+//                - parent reaps them
+void workqueue_stop(void)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        list_entry_t *le = &wq_list;
+        while ((le = list_next(le)) != &wq_list)
+        {
+            struct workqueue *wq = to_struct(le, struct workqueue, wq_link);
+            wq->exiting = 1;
+            wake_workers(wq);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+void print_workqueue_stats(void)
+{
+    list_entry_t *le = &wq_list;
+    while ((le = list_next(le)) != &wq_list)
+    {
+        struct workqueue *wq = to_struct(le, struct workqueue, wq_link);
+        struct workqueue_stats *stats = &(wq->stats);
+        cprintf("wq %-15s %d workers, depth %llu (max %llu), %d running, %llu queued, %llu done\n",
+                wq->name, wq->nr_workers, wq->depth, stats->max_depth, wq->running,
+                stats->queued, stats->done);
+        cprintf("   latency: avg %llu, max %llu ticks\n",
+                stats->done == 0 ? 0 : stats->latency / stats->done, stats->max_latency);
+    }
+}
+
+// workqueue_init - create system_wq, its workers start with workqueue_start
+void workqueue_init(void)
+{
+    check_workqueue();
+    if ((system_wq = create_workqueue("events", SYSTEM_WQ_WORKERS)) == NULL)
+    {
+        panic("cannot create system_wq.\n");
+    }
+}
+
+static struct workqueue *check_wq;
+static struct work_struct *check_order[4];
+static int check_runs;
+
+static void
+check_work_func(struct work_struct *work)
+{
+    check_order[check_runs++] = work;
+}
+
+// check_requeue_func - queue itself once more, while it runs
+static void
+check_requeue_func(struct work_struct *work)
+{
+    check_work_func(work);
+    if (check_runs == 2)
+    {
+        assert(queue_work(check_wq, work));
+    }
+}
+
+// check_workqueue - run by the boot thread before any worker exists, so the
+//                 - works are run by flush_workqueue
+static void
+check_workqueue(void)
+{
+    struct work_struct works[3];
+    int i;
+    assert(list_empty(&wq_list));
+    struct workqueue *wq = check_wq = create_workqueue("check", 1);
+    assert(wq != NULL && wq->nr_workers == 0);
+    assert(create_workqueue("check", 0) == NULL && create_workqueue("check", WQ_MAX_WORKERS + 1) == NULL);
+
+    // works run once each, in queueing order
+    INIT_WORK(&works[0], check_work_func);
+    INIT_WORK(&works[1], check_requeue_func);
+    INIT_WORK(&works[2], check_work_func);
+    for (i = 0; i < 3; i++)
+    {
+        assert(queue_work(wq, &works[i]) && works[i].pending);
+    }
+    assert(!queue_work(wq, &works[0]) && !queue_work(wq, &works[1]));
+    assert(wq->depth == 3 && wq->stats.queued == 3 && wq->stats.max_depth == 3);
+
+    // a work may queue itself again while it runs, it then runs last
+    flush_workqueue(wq);
+    assert(check_runs == 4 && wq->depth == 0 && wq->running == 0 && wq->stats.done == 4);
+    assert(check_order[0] == &works[0] && check_order[1] == &works[1]);
+    assert(check_order[2] == &works[2] && check_order[3] == &works[1]);
+    for (i = 0; i < 3; i++)
+    {
+        assert(!works[i].pending && list_empty(&(works[i].work_link)));
+    }
+
+    destroy_workqueue(wq);
+    assert(list_empty(&wq_list));
+    cprintf("check_workqueue() succeeded!\n");
+}
@@ -0,0 +1,80 @@
+#ifndef __KERN_PROCESS_WORKQUEUE_H__
+#define __KERN_PROCESS_WORKQUEUE_H__
+
+#include <defs.h>
+#include <list.h>
+#include <wait.h>
+
+#define WQ_NAME_LEN 15
+#define WQ_MAX_WORKERS 4    // worker threads of a workqueue at most
+#define SYSTEM_WQ_WORKERS 2 // worker threads of system_wq
+
+struct work_struct;
+
+typedef void (*work_func_t)(struct work_struct *work);
+
+// a piece of deferred work, usually inside the object it works on
+struct work_struct
+{
+    work_func_t func;       // run by a worker thread, may free the work
+    bool pending;           // queued and not started yet, queueing again is a no-op
+    size_t queued_at;       // ticks when queued, for the latency stats
+    list_entry_t work_link; // link in the queue of the workqueue
+};
+
+#define le2work(le, member) \
+    to_struct((le), struct work_struct, member)
+
+#define INIT_WORK(work, fn)                   \
+    do                                        \
+    {                                         \
+        (work)->func = (fn);                  \
+        (work)->pending = 0;                  \
+        list_init(&((work)->work_link));      \
+    } while (0)
+
+struct workqueue_stats
+{
+    size_t queued;      // works queued
+    size_t done;        // works run
+    size_t max_depth;   // most works queued at once
+    size_t latency;     // ticks from queueing to start, summed over the works run
+    size_t max_latency; // the longest of them
+};
+
+// a queue of works and the pool of kernel threads running them in order.
+// the queue would be per cpu, ucore has one hart and so one queue
+struct workqueue
+{
+    char name[WQ_NAME_LEN + 1];
+    list_entry_t works;       // the queued works, oldest first
+    size_t depth;             // works queued
+    int running;              // works being run by a worker
+    int nr_workers;           // worker threads alive
+    int max_workers;          // worker threads to start
+    bool exiting;             // workers exit once the queue is empty
+    wait_queue_t idle_queue;  // idle workers sleep here
+    wait_queue_t flush_queue; // flush_workqueue sleeps here
+    struct workqueue_stats stats;
+    list_entry_t wq_link;     // link in the list of all workqueues
+};
+
+extern struct workqueue *system_wq;
+
+void workqueue_init(void);
+int workqueue_start(void);
+void workqueue_stop(void);
+struct workqueue *create_workqueue(const char *name, int nr_workers);
+void destroy_workqueue(struct workqueue *wq);
+bool queue_work(struct workqueue *wq, struct work_struct *work);
+void flush_workqueue(struct workqueue *wq);
+void print_workqueue_stats(void);
+
+// schedule_work - queue work on system_wq, from any context
+static inline bool
+schedule_work(struct work_struct *work)
+{
+    return queue_work(system_wq, work);
+}
+
+#endif /* !__KERN_PROCESS_WORKQUEUE_H__ */
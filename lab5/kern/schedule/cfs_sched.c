@@ -0,0 +1,277 @@
+#include <defs.h>
+#include <list.h>
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <kmalloc.h>
+#include <clock.h>
+#include <rbtree.h>
+#include <cfs_sched.h>
+
+/* *
+ * Fair scheduling, after the CFS of Linux: every process has a virtual
+ * runtime, the nanoseconds it ran (read from the time csr) divided by its
+ * weight, its priority, and the runnable one with the least vruntime runs
+ * next. The runnable processes are kept in a red-black tree ordered by
+ * vruntime, with the leftmost one cached, so picking is O(1) and queueing
+ * O(log n).
+ *
+ * The running process is preempted once it ran its slice, its weight's
+ * share of cfs_latency_ns, but never before cfs_min_granularity_ns. A
+ * process asleep for long would come back far behind everyone else and keep
+ * the cpu until it caught up: it starts again at most half a latency before
+ * min_vruntime instead, enough credit to run first without hogging the cpu.
+ * A new process starts at min_vruntime.
+ * */
+
+uint64_t cfs_latency_ns = CFS_LATENCY_NS;
+uint64_t cfs_min_granularity_ns = CFS_MIN_GRANULARITY_NS;
+
+#define le2proc_node(node) \
+    rb_entry((node), struct proc_struct, run_node)
+
+static inline uint64_t
+cfs_weight(struct proc_struct *proc)
+{
+    return (proc->priority != 0) ? proc->priority : DEFAULT_PRIORITY;
+}
+
+// vruntime_before - whether a comes before b, as a signed difference
+static inline bool
+vruntime_before(uint64_t a, uint64_t b)
+{
+    return (int64_t)(a - b) < 0;
+}
+
+static void
+cfs_init(struct run_queue *rq)
+{
+    list_init(&(rq->run_list));
+    rq->cfs_tree.rb_node = NULL;
+    rq->cfs_leftmost = NULL;
+    rq->cfs_load = 0;
+    rq->min_vruntime = 0;
+    rq->proc_num = 0;
+}
+
+// cfs_update_min_vruntime - move min_vruntime up to the least vruntime of
+//                         - curr, the process running if any, and the queued ones
+static void
+cfs_update_min_vruntime(struct run_queue *rq, struct proc_struct *curr)
+{
+    uint64_t vruntime = rq->min_vruntime;
+    bool found = 0;
+    if (curr != NULL)
+    {
+        vruntime = curr->vruntime, found = 1;
+    }
+    if (rq->cfs_leftmost != NULL)
+    {
+        struct proc_struct *left = le2proc_node(rq->cfs_leftmost);
+        if (!found || vruntime_before(left->vruntime, vruntime))
+        {
+            vruntime = left->vruntime, found = 1;
+        }
+    }
+    if (found && vruntime_before(rq->min_vruntime, vruntime))
+    {
+        rq->min_vruntime = vruntime;
+    }
+}
+
+// cfs_update_curr - charge the running proc the time it ran since last time
+static void
+cfs_update_curr(struct run_queue *rq, struct proc_struct *proc)
+{
+    uint64_t now = clock_gettime_nsec();
+    uint64_t delta = now - proc->exec_start;
+    proc->exec_start = now;
+    proc->vruntime += delta * DEFAULT_PRIORITY / cfs_weight(proc);
+    cfs_update_min_vruntime(rq, proc);
+}
+
+// cfs_slice - the ns proc may run before it is preempted, its weight's share
+//           - of the period every runnable process should run once in
+static uint64_t
+cfs_slice(struct run_queue *rq, struct proc_struct *proc)
+{
+    uint64_t nr = rq->proc_num + 1, load = rq->cfs_load + cfs_weight(proc);
+    uint64_t period = cfs_latency_ns;
+    if (nr * cfs_min_granularity_ns > period)
+    {
+        period = nr * cfs_min_granularity_ns;
+    }
+    uint64_t slice = period * cfs_weight(proc) / load;
+    return (slice > cfs_min_granularity_ns) ? slice : cfs_min_granularity_ns;
+}
+
+// cfs_enqueue - put proc in the tree. a process put back by schedule keeps
+//             - its vruntime, one new or woken up starts near min_vruntime
+static void
+cfs_enqueue(struct run_queue *rq, struct proc_struct *proc)
+{
+    if (proc != current)
+    {
+        uint64_t start = rq->min_vruntime;
+        if (proc->runs != 0)
+        {
+            start -= cfs_latency_ns / 2;
+        }
+        if (vruntime_before(proc->vruntime, start))
+        {
+            proc->vruntime = start;
+        }
+    }
+
+    struct rb_node **link = &(rq->cfs_tree.rb_node), *parent = NULL;
+    bool leftmost = 1;
+    while (*link != NULL)
+    {
+        parent = *link;
+        if (vruntime_before(proc->vruntime, le2proc_node(parent)->vruntime))
+        {
+            link = &(parent->rb_left);
+        }
+        else
+        {
+            link = &(parent->rb_right), leftmost = 0;
+        }
+    }
+    rb_link_node(&(proc->run_node), parent, link);
+    rb_insert_color(&(proc->run_node), &(rq->cfs_tree));
+    if (leftmost)
+    {
+        rq->cfs_leftmost = &(proc->run_node);
+    }
+    rq->cfs_load += cfs_weight(proc);
+    rq->proc_num++;
+}
+
+static void
+cfs_dequeue(struct run_queue *rq, struct proc_struct *proc)
+{
+    assert(rq->proc_num > 0);
+    if (rq->cfs_leftmost == &(proc->run_node))
+    {
+        rq->cfs_leftmost = rb_next(&(proc->run_node));
+    }
+    rb_erase(&(proc->run_node), &(rq->cfs_tree));
+    rq->cfs_load -= cfs_weight(proc);
+    rq->proc_num--;
+}
+
+// cfs_pick_next - the process with the least vruntime, its clock started
+static struct proc_struct *
+cfs_pick_next(struct run_queue *rq)
+{
+    if (rq->cfs_leftmost == NULL)
+    {
+        return NULL;
+    }
+    struct proc_struct *proc = le2proc_node(rq->cfs_leftmost);
+    proc->exec_start = proc->slice_start = clock_gettime_nsec();
+    return proc;
+}
+
+// cfs_proc_tick - charge the running proc, which gives the cpu away once it
+//               - ran its slice, or ran long enough and is a slice ahead of
+//               - the first one waiting
+static void
+cfs_proc_tick(struct run_queue *rq, struct proc_struct *proc)
+{
+    cfs_update_curr(rq, proc);
+    uint64_t ran = proc->exec_start - proc->slice_start, slice = cfs_slice(rq, proc);
+    if (ran >= slice)
+    {
+        proc->need_resched = 1;
+    }
+    else if (ran >= cfs_min_granularity_ns && rq->cfs_leftmost != NULL)
+    {
+        struct proc_struct *left = le2proc_node(rq->cfs_leftmost);
+        if ((int64_t)(proc->vruntime - left->vruntime) > (int64_t)slice)
+        {
+            proc->need_resched = 1;
+        }
+    }
+}
+
+// cfs_put_prev - charge the running proc before it gives the cpu away, even
+//              - if it blocks between two ticks
+static void
+cfs_put_prev(struct run_queue *rq, struct proc_struct *proc)
+{
+    cfs_update_curr(rq, proc);
+}
+
+struct sched_class cfs_sched_class = {
+    .name = "CFS_scheduler",
+    .init = cfs_init,
+    .enqueue = cfs_enqueue,
+    .dequeue = cfs_dequeue,
+    .pick_next = cfs_pick_next,
+    .proc_tick = cfs_proc_tick,
+    .put_prev = cfs_put_prev,
+};
+
+#define CHECK_NPROC 32
+
+// check_cfs_sched - run the fair scheduler on a run queue of its own, with
+//                 - processes faked, whatever the scheduling class in use
+void check_cfs_sched(void)
+{
+    struct proc_struct *procs = kmalloc(CHECK_NPROC * sizeof(struct proc_struct));
+    struct run_queue rq;
+    int i, n;
+    assert(procs != NULL);
+
+    memset(procs, 0, CHECK_NPROC * sizeof(struct proc_struct));
+    cfs_init(&rq);
+
+    // queued in any order, taken out anywhere, they run by vruntime
+    for (i = 0; i < CHECK_NPROC; i++)
+    {
+        struct proc_struct *proc = procs + (i * 7) % CHECK_NPROC;
+        proc->priority = DEFAULT_PRIORITY, proc->runs = 1;
+        proc->vruntime = cfs_latency_ns + (i * 13) % 5 * 1000;
+        cfs_enqueue(&rq, proc);
+    }
+    assert(rq.proc_num == CHECK_NPROC && rq.cfs_load == CHECK_NPROC * DEFAULT_PRIORITY);
+    for (i = 0; i < CHECK_NPROC; i += 3)
+    {
+        cfs_dequeue(&rq, procs + i);
+    }
+    uint64_t vruntime = 0;
+    for (n = 0; rq.cfs_leftmost != NULL; n++)
+    {
+        struct proc_struct *proc = cfs_pick_next(&rq);
+        assert(proc >= procs && proc < procs + CHECK_NPROC && (proc - procs) % 3 != 0);
+        assert(proc->vruntime >= vruntime);
+        vruntime = proc->vruntime;
+        cfs_dequeue(&rq, proc);
+    }
+    assert(n == CHECK_NPROC - (CHECK_NPROC + 2) / 3);
+    assert(rq.proc_num == 0 && rq.cfs_load == 0 && rq.cfs_tree.rb_node == NULL);
+
+    // a sleeper gets half a latency of credit, a new process none
+    rq.min_vruntime = 10 * cfs_latency_ns;
+    procs[0].vruntime = procs[1].vruntime = 0;
+    procs[0].runs = 1, procs[1].runs = 0;
+    cfs_enqueue(&rq, procs + 1);
+    cfs_enqueue(&rq, procs);
+    assert(procs[0].vruntime == rq.min_vruntime - cfs_latency_ns / 2);
+    assert(procs[1].vruntime == rq.min_vruntime);
+    assert(cfs_pick_next(&rq) == procs);
+
+    // and slices follow the weights, with a priority 3 one next to it
+    procs[2].priority = 3;
+    uint64_t period = (3 * cfs_min_granularity_ns > cfs_latency_ns) ? 3 * cfs_min_granularity_ns : cfs_latency_ns;
+    uint64_t slice = period * 3 / 5;
+    assert(cfs_slice(&rq, procs + 2) == ((slice > cfs_min_granularity_ns) ? slice : cfs_min_granularity_ns));
+    cfs_dequeue(&rq, procs);
+    cfs_dequeue(&rq, procs + 1);
+
+    kfree(procs);
+    cprintf("check_cfs_sched() succeeded!\n");
+}
@@ -0,0 +1,26 @@
+#ifndef __KERN_SCHEDULE_SCHED_CFS_H__
+#define __KERN_SCHEDULE_SCHED_CFS_H__
+
+#include <defs.h>
+#include <sched.h>
+
+// the period in which every runnable process should get to run once, as
+// long as there are few of them
+#ifndef CFS_LATENCY_NS
+#define CFS_LATENCY_NS 40000000
+#endif
+
+// the least a process runs before it may be preempted. past latency /
+// min_granularity runnable processes, it stretches the period instead
+#ifndef CFS_MIN_GRANULARITY_NS
+#define CFS_MIN_GRANULARITY_NS 10000000
+#endif
+
+extern uint64_t cfs_latency_ns;
+extern uint64_t cfs_min_granularity_ns;
+
+extern struct sched_class cfs_sched_class;
+
+void check_cfs_sched(void);
+
+#endif /* !__KERN_SCHEDULE_SCHED_CFS_H__ */
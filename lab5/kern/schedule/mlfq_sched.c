@@ -0,0 +1,241 @@
+#include <defs.h>
+#include <list.h>
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <kmalloc.h>
+#include <mlfq_sched.h>
+
+/* *
+ * Multi-level feedback queue: MLFQ_LEVELS round robin queues, the first
+ * non-empty one runs, and the quantum doubles from one level to the next.
+ * A process starts at level 0 and goes one level down each time it uses up
+ * its quantum, one level up each time it blocks before. So CPU bound batch
+ * jobs sink to the bottom with long quanta, while interactive processes
+ * that mostly sleep stay at the top and, woken up, preempt them at the next
+ * tick. Every MLFQ_BOOST_TICKS ticks everyone goes back to level 0, or the
+ * bottom could starve behind a steady stream of interactive work.
+ * */
+
+struct mlfq_stats mlfq_stats;
+
+static inline int
+mlfq_quantum(int level)
+{
+    return MLFQ_QUANTUM << level;
+}
+
+static void
+mlfq_init(struct run_queue *rq)
+{
+    int level;
+    list_init(&(rq->run_list));
+    for (level = 0; level < MLFQ_LEVELS; level++)
+    {
+        list_init(&(rq->mlfq_queues[level]));
+        rq->mlfq_len[level] = 0;
+    }
+    rq->mlfq_ticks = 0;
+    rq->proc_num = 0;
+}
+
+// mlfq_enqueue - queue proc at the tail of its level, with a full quantum
+//              - if it has none left
+static void
+mlfq_enqueue(struct run_queue *rq, struct proc_struct *proc)
+{
+    int level = proc->mlfq_level;
+    assert(level >= 0 && level < MLFQ_LEVELS && list_empty(&(proc->run_link)));
+    list_add_before(&(rq->mlfq_queues[level]), &(proc->run_link));
+    if (proc->time_slice <= 0 || proc->time_slice > mlfq_quantum(level))
+    {
+        proc->time_slice = mlfq_quantum(level);
+    }
+    rq->mlfq_len[level]++;
+    rq->proc_num++;
+}
+
+static void
+mlfq_dequeue(struct run_queue *rq, struct proc_struct *proc)
+{
+    assert(!list_empty(&(proc->run_link)) && rq->mlfq_len[proc->mlfq_level] > 0);
+    list_del_init(&(proc->run_link));
+    rq->mlfq_len[proc->mlfq_level]--;
+    rq->proc_num--;
+}
+
+// mlfq_pick_next - the head of the first non-empty level
+static struct proc_struct *
+mlfq_pick_next(struct run_queue *rq)
+{
+    int level;
+    for (level = 0; level < MLFQ_LEVELS; level++)
+    {
+        if (!list_empty(&(rq->mlfq_queues[level])))
+        {
+            return le2proc(list_next(&(rq->mlfq_queues[level])), run_link);
+        }
+    }
+    return NULL;
+}
+
+// mlfq_boost - every process, queued or curr running, back to level 0
+static void
+mlfq_boost(struct run_queue *rq, struct proc_struct *curr)
+{
+    int level;
+    for (level = 1; level < MLFQ_LEVELS; level++)
+    {
+        list_entry_t *list = &(rq->mlfq_queues[level]), *le;
+        while ((le = list_next(list)) != list)
+        {
+            struct proc_struct *proc = le2proc(le, run_link);
+            list_del(le);
+            list_add_before(&(rq->mlfq_queues[0]), le);
+            proc->mlfq_level = 0, proc->time_slice = mlfq_quantum(0);
+        }
+        rq->mlfq_len[0] += rq->mlfq_len[level];
+        rq->mlfq_len[level] = 0;
+    }
+    if (curr->mlfq_level != 0)
+    {
+        curr->mlfq_level = 0, curr->time_slice = mlfq_quantum(0);
+    }
+    rq->mlfq_ticks = 0;
+    mlfq_stats.boosts++;
+}
+
+// mlfq_proc_tick - charge a tick to the running proc, which goes one level
+//                - down once its quantum is used up, and gives the cpu to
+//                - any process queued at a higher level
+static void
+mlfq_proc_tick(struct run_queue *rq, struct proc_struct *proc)
+{
+    if (proc->time_slice > 0)
+    {
+        proc->time_slice--;
+    }
+    if (proc->time_slice == 0)
+    {
+        if (proc->mlfq_level < MLFQ_LEVELS - 1)
+        {
+            proc->mlfq_level++;
+            mlfq_stats.demotions++;
+        }
+        proc->time_slice = mlfq_quantum(proc->mlfq_level);
+        proc->need_resched = 1;
+    }
+    else
+    {
+        int level;
+        for (level = 0; level < proc->mlfq_level; level++)
+        {
+            if (rq->mlfq_len[level] != 0)
+            {
+                proc->need_resched = 1;
+                break;
+            }
+        }
+    }
+    if (++rq->mlfq_ticks >= MLFQ_BOOST_TICKS)
+    {
+        mlfq_boost(rq, proc);
+    }
+}
+
+// mlfq_put_prev - the running proc blocking before its quantum is used up
+//               - goes one level up, with a full quantum of that level
+static void
+mlfq_put_prev(struct run_queue *rq, struct proc_struct *proc)
+{
+    if (proc->state != PROC_RUNNABLE)
+    {
+        if (proc->mlfq_level > 0)
+        {
+            proc->mlfq_level--;
+            mlfq_stats.promotions++;
+        }
+        proc->time_slice = mlfq_quantum(proc->mlfq_level);
+    }
+}
+
+struct sched_class mlfq_sched_class = {
+    .name = "MLFQ_scheduler",
+    .init = mlfq_init,
+    .enqueue = mlfq_enqueue,
+    .dequeue = mlfq_dequeue,
+    .pick_next = mlfq_pick_next,
+    .proc_tick = mlfq_proc_tick,
+    .put_prev = mlfq_put_prev,
+};
+
+// check_mlfq_sched - run the mlfq scheduler on a run queue of its own, with
+//                  - processes faked, whatever the scheduling class in use
+void check_mlfq_sched(void)
+{
+    struct proc_struct *procs = kmalloc(3 * sizeof(struct proc_struct));
+    struct proc_struct *batch = procs, *interactive = procs + 1, *other = procs + 2;
+    struct mlfq_stats old = mlfq_stats;
+    struct run_queue rq;
+    int i;
+    assert(procs != NULL);
+
+    memset(procs, 0, 3 * sizeof(struct proc_struct));
+    mlfq_init(&rq);
+    for (i = 0; i < 3; i++)
+    {
+        list_init(&(procs[i].run_link));
+        procs[i].state = PROC_RUNNABLE;
+    }
+
+    // a process using up its quanta sinks down to the bottom level
+    for (i = 0; i < MLFQ_LEVELS + 1; i++)
+    {
+        int ticks = batch->time_slice = mlfq_quantum(batch->mlfq_level);
+        while (ticks-- > 0)
+        {
+            assert(!batch->need_resched);
+            mlfq_proc_tick(&rq, batch);
+        }
+        assert(batch->need_resched);
+        batch->need_resched = 0;
+    }
+    assert(batch->mlfq_level == MLFQ_LEVELS - 1 && mlfq_stats.demotions == old.demotions + MLFQ_LEVELS - 1);
+    assert(batch->time_slice == mlfq_quantum(MLFQ_LEVELS - 1));
+
+    // where the levels above run first, and preempt it at the next tick
+    mlfq_enqueue(&rq, batch);
+    mlfq_enqueue(&rq, interactive);
+    assert(rq.mlfq_len[0] == 1 && rq.mlfq_len[MLFQ_LEVELS - 1] == 1);
+    assert(mlfq_pick_next(&rq) == interactive);
+    mlfq_dequeue(&rq, interactive);
+    mlfq_dequeue(&rq, batch);
+    mlfq_enqueue(&rq, interactive);
+    mlfq_proc_tick(&rq, batch);
+    assert(batch->need_resched);
+    mlfq_dequeue(&rq, interactive);
+
+    // a process blocking before its quantum is used up goes one level up
+    batch->state = PROC_SLEEPING;
+    mlfq_put_prev(&rq, batch);
+    assert(batch->mlfq_level == MLFQ_LEVELS - 2 && mlfq_stats.promotions == old.promotions + 1);
+
+    // and a boost brings everyone back to level 0
+    mlfq_enqueue(&rq, batch);
+    other->mlfq_level = 1;
+    rq.mlfq_ticks = 0;
+    for (i = 0; i < MLFQ_BOOST_TICKS; i++)
+    {
+        other->time_slice = mlfq_quantum(other->mlfq_level);
+        mlfq_proc_tick(&rq, other);
+    }
+    assert(mlfq_stats.boosts == old.boosts + 1 && batch->mlfq_level == 0 && other->mlfq_level == 0);
+    assert(rq.mlfq_len[0] == 1 && rq.mlfq_len[MLFQ_LEVELS - 2] == 0 && mlfq_pick_next(&rq) == batch);
+    mlfq_dequeue(&rq, batch);
+    assert(rq.proc_num == 0);
+
+    mlfq_stats = old;
+    kfree(procs);
+    cprintf("check_mlfq_sched() succeeded!\n");
+}
@@ -0,0 +1,31 @@
+#ifndef __KERN_SCHEDULE_SCHED_MLFQ_H__
+#define __KERN_SCHEDULE_SCHED_MLFQ_H__
+
+#include <defs.h>
+#include <sched.h>
+
+// the quantum of level i is MLFQ_QUANTUM << i ticks
+#ifndef MLFQ_QUANTUM
+#define MLFQ_QUANTUM 1
+#endif
+
+// every MLFQ_BOOST_TICKS ticks all processes go back to level 0, so the
+// ones at the bottom do not starve
+#ifndef MLFQ_BOOST_TICKS
+#define MLFQ_BOOST_TICKS 100
+#endif
+
+struct mlfq_stats
+{
+    size_t demotions;  // quanta used up, one level down
+    size_t promotions; // blocked before that, one level up
+    size_t boosts;     // times every process went back to level 0
+};
+
+extern struct mlfq_stats mlfq_stats;
+
+extern struct sched_class mlfq_sched_class;
+
+void check_mlfq_sched(void);
+
+#endif /* !__KERN_SCHEDULE_SCHED_MLFQ_H__ */
@@ -2,7 +2,102 @@
 #include <sync.h>
 #include <proc.h>
 #include <sched.h>
+#include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <kmalloc.h>
+#include <default_sched.h>
+#include <stride_sched.h>
+#include <cfs_sched.h>
+#include <mlfq_sched.h>
+
+static list_entry_t timer_list;
+
+static struct sched_class *sched_classes[] = {
+    [SCHED_RR] = &default_sched_class,
+    [SCHED_STRIDE] = &stride_sched_class,
+    [SCHED_CFS] = &cfs_sched_class,
+    [SCHED_MLFQ] = &mlfq_sched_class,
+};
+
+static struct sched_class *sched_class;
+
+static struct run_queue *rq;
+
+static void check_sched_class(void);
+
+static inline void
+sched_class_enqueue(struct proc_struct *proc)
+{
+    if (proc != idleproc)
+    {
+        assert(proc->rq == NULL);
+        sched_class->enqueue(rq, proc);
+        proc->rq = rq;
+    }
+}
+
+static inline void
+sched_class_dequeue(struct proc_struct *proc)
+{
+    assert(proc->rq == rq);
+    sched_class->dequeue(rq, proc);
+    proc->rq = NULL;
+}
+
+static inline struct proc_struct *
+sched_class_pick_next(void)
+{
+    return sched_class->pick_next(rq);
+}
+
+// sched_class_proc_tick - called by the clock interrupt every tick for the
+//                       - running proc. idleproc gives the cpu away at once
+void sched_class_proc_tick(struct proc_struct *proc)
+{
+    if (proc != idleproc)
+    {
+        sched_class->proc_tick(rq, proc);
+    }
+    else
+    {
+        proc->need_resched = 1;
+    }
+}
+
+// sched_dequeue - take proc off the run queue if it is there, e.g. a
+//               - process faked by a check and woken up
+void sched_dequeue(struct proc_struct *proc)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (proc->rq != NULL)
+        {
+            sched_class_dequeue(proc);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+void sched_init(void)
+{
+    list_init(&timer_list);
+
+    static_assert(SCHED_POLICY >= 0 && SCHED_POLICY < sizeof(sched_classes) / sizeof(sched_classes[0]));
+    sched_class = sched_classes[SCHED_POLICY];
+
+    static struct run_queue __rq;
+    rq = &__rq;
+    rq->max_time_slice = MAX_TIME_SLICE;
+    sched_class->init(rq);
+
+    cprintf("sched class: %s\n", sched_class->name);
+    check_sched_class();
+    check_cfs_sched();
+    check_mlfq_sched();
+    check_wait_queue();
+}
 
 void wakeup_proc(struct proc_struct *proc)
 {
@@ -14,6 +109,11 @@ void wakeup_proc(struct proc_struct *proc)
         {
             proc->state = PROC_RUNNABLE;
             proc->wait_state = 0;
+            // current is put back by schedule, if it has not blocked since
+            if (proc != current)
+            {
+                sched_class_enqueue(proc);
+            }
         }
         else
         {
@@ -23,28 +123,28 @@ void wakeup_proc(struct proc_struct *proc)
     local_intr_restore(intr_flag);
 }
 
+// schedule - give the cpu to the process the sched_class picks, current
+//          - goes back to the run queue unless it is blocking or exiting
 void schedule(void)
 {
     bool intr_flag;
-    list_entry_t *le, *last;
-    struct proc_struct *next = NULL;
+    struct proc_struct *next;
     local_intr_save(intr_flag);
     {
         current->need_resched = 0;
-        last = (current == idleproc) ? &proc_list : &(current->list_link);
-        le = last;
-        do
+        if (current != idleproc && sched_class->put_prev != NULL)
         {
-            if ((le = list_next(le)) != &proc_list)
-            {
-                next = le2proc(le, list_link);
-                if (next->state == PROC_RUNNABLE)
-                {
-                    break;
-                }
-            }
-        } while (le != last);
-        if (next == NULL || next->state != PROC_RUNNABLE)
+            sched_class->put_prev(rq, current);
+        }
+        if (current->state == PROC_RUNNABLE)
+        {
+            sched_class_enqueue(current);
+        }
+        if ((next = sched_class_pick_next()) != NULL)
+        {
+            sched_class_dequeue(next);
+        }
+        else
         {
             next = idleproc;
         }
@@ -56,3 +156,180 @@ void schedule(void)
     }
     local_intr_restore(intr_flag);
 }
+
+// add_timer - add timer to the timer list, expires is relative to now
+void add_timer(timer_t *timer)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        assert(timer->expires > 0 && timer->proc != NULL);
+        assert(list_empty(&(timer->timer_link)));
+        list_entry_t *le = list_next(&timer_list);
+        while (le != &timer_list)
+        {
+            timer_t *next = le2timer(le, timer_link);
+            if (timer->expires < next->expires)
+            {
+                next->expires -= timer->expires;
+                break;
+            }
+            timer->expires -= next->expires;
+            le = list_next(le);
+        }
+        list_add_before(le, &(timer->timer_link));
+    }
+    local_intr_restore(intr_flag);
+}
+
+// del_timer - remove timer from the timer list, if it is still there
+void del_timer(timer_t *timer)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (!list_empty(&(timer->timer_link)))
+        {
+            if (timer->expires != 0)
+            {
+                list_entry_t *le = list_next(&(timer->timer_link));
+                if (le != &timer_list)
+                {
+                    timer_t *next = le2timer(le, timer_link);
+                    next->expires += timer->expires;
+                }
+            }
+            list_del_init(&(timer->timer_link));
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+// run_timer_list - called by the clock interrupt every tick, wake up the
+//                - processes whose timers expired and let them run soon
+void run_timer_list(void)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        list_entry_t *le = list_next(&timer_list);
+        if (le != &timer_list)
+        {
+            timer_t *timer = le2timer(le, timer_link);
+            assert(timer->expires != 0);
+            timer->expires--;
+            while (timer->expires == 0)
+            {
+                le = list_next(le);
+                struct proc_struct *proc = timer->proc;
+                if (proc->wait_state != 0)
+                {
+                    assert(proc->wait_state & WT_INTERRUPTED);
+                }
+                else
+                {
+                    warn("process %d's wait_state == 0.\n", proc->pid);
+                }
+                if (proc->state != PROC_RUNNABLE)
+                {
+                    wakeup_proc(proc);
+                }
+                del_timer(timer);
+                if (current != NULL)
+                {
+                    current->need_resched = 1;
+                }
+                if (le == &timer_list)
+                {
+                    break;
+                }
+                timer = le2timer(le, timer_link);
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+// print_sched - the scheduling class in use and how many processes wait to run
+void print_sched(void)
+{
+    cprintf("sched: %s, %d processes waiting to run\n", sched_class->name, rq->proc_num);
+    if (sched_class == &cfs_sched_class)
+    {
+        cprintf("sched: latency %d ms, min granularity %d ms, min_vruntime %d ms\n",
+                (int)(cfs_latency_ns / 1000000), (int)(cfs_min_granularity_ns / 1000000),
+                (int)(rq->min_vruntime / 1000000));
+    }
+    if (sched_class == &mlfq_sched_class)
+    {
+        int level;
+        cprintf("sched: queue lengths by level:");
+        for (level = 0; level < MLFQ_LEVELS; level++)
+        {
+            cprintf(" %u", rq->mlfq_len[level]);
+        }
+        cprintf(", quantum %d tick(s) at level 0\n", MLFQ_QUANTUM);
+        cprintf("sched: %llu demotions, %llu promotions, %llu boosts every %d ticks\n",
+                mlfq_stats.demotions, mlfq_stats.promotions, mlfq_stats.boosts, MLFQ_BOOST_TICKS);
+    }
+}
+
+// check_sched_class - run the sched_class on a run queue of its own, with
+//                   - processes faked as none can run yet
+static void
+check_sched_class(void)
+{
+    struct proc_struct *procs = kmalloc(4 * sizeof(struct proc_struct));
+    struct run_queue check_rq;
+    bool picked[4] = {0};
+    int i;
+    assert(procs != NULL);
+
+    // the time slice in ticks a new process gets from the class, CFS counts none
+    int quantum = MAX_TIME_SLICE;
+    if (sched_class == &mlfq_sched_class)
+    {
+        quantum = MLFQ_QUANTUM;
+    }
+    else if (sched_class == &cfs_sched_class)
+    {
+        quantum = 0;
+    }
+
+    memset(procs, 0, 4 * sizeof(struct proc_struct));
+    check_rq.max_time_slice = MAX_TIME_SLICE;
+    sched_class->init(&check_rq);
+    assert(sched_class->pick_next(&check_rq) == NULL);
+    for (i = 0; i < 4; i++)
+    {
+        list_init(&(procs[i].run_link));
+        sched_class->enqueue(&check_rq, procs + i);
+        assert(procs[i].time_slice == quantum);
+    }
+    assert(check_rq.proc_num == 4);
+
+    // every process queued is picked once
+    for (i = 0; i < 4; i++)
+    {
+        struct proc_struct *proc = sched_class->pick_next(&check_rq);
+        assert(proc >= procs && proc < procs + 4 && !picked[proc - procs]);
+        picked[proc - procs] = 1;
+        sched_class->dequeue(&check_rq, proc);
+    }
+    assert(check_rq.proc_num == 0 && sched_class->pick_next(&check_rq) == NULL);
+
+    // and with time slices counted in ticks, the one running gives the cpu
+    // away once its time slice is used up
+    if (quantum != 0)
+    {
+        for (i = 0; i < quantum; i++)
+        {
+            assert(!procs[0].need_resched);
+            sched_class->proc_tick(&check_rq, procs);
+        }
+        assert(procs[0].need_resched);
+    }
+
+    kfree(procs);
+    cprintf("check_sched_class() succeeded!\n");
+}
@@ -1,10 +1,97 @@
 #ifndef __KERN_SCHEDULE_SCHED_H__
 #define __KERN_SCHEDULE_SCHED_H__
 
+#include <defs.h>
+#include <list.h>
 #include <proc.h>
+#include <rbtree.h>
 
+#define MAX_TIME_SLICE 5 // ticks a process runs before the cpu goes to the next one
+
+// the scheduling classes, sched_init uses the one of SCHED_POLICY
+#define SCHED_RR 0     // round robin, see default_sched.c
+#define SCHED_STRIDE 1 // stride scheduling by priority, see stride_sched.c
+#define SCHED_CFS 2    // fair scheduling by virtual runtime, see cfs_sched.c
+#define SCHED_MLFQ 3   // multi-level feedback queue, see mlfq_sched.c
+
+#define MLFQ_LEVELS 4 // the queues of the multi-level feedback queue, 0 runs first
+
+#ifndef SCHED_POLICY
+#define SCHED_POLICY SCHED_STRIDE
+#endif
+
+// a timer of a sleeping process. the timer list is kept in expiry order and
+// expires holds the ticks left after the timer before it, so a clock tick
+// only decrements the first one
+typedef struct
+{
+    unsigned int expires;     // the expire time
+    struct proc_struct *proc; // the proc wait in this timer
+    list_entry_t timer_link;  // the timer list
+} timer_t;
+
+#define le2timer(le, member) \
+    to_struct((le), timer_t, member)
+
+// timer_init - initialize a timer which wakes proc after expires ticks
+static inline timer_t *
+timer_init(timer_t *timer, struct proc_struct *proc, int expires)
+{
+    timer->expires = expires;
+    timer->proc = proc;
+    list_init(&(timer->timer_link));
+    return timer;
+}
+
+struct run_queue;
+
+// a scheduling class, the policy choosing which runnable process runs next.
+// the run queue holds the runnable processes except current and idleproc:
+// schedule puts current back if it is still runnable, wakeup_proc adds the
+// processes woken up, and a process blocking is simply not put back
+struct sched_class
+{
+    // the name of sched_class
+    const char *name;
+    // Init the run queue
+    void (*init)(struct run_queue *rq);
+    // put the proc into runqueue, called with interrupts off
+    void (*enqueue)(struct run_queue *rq, struct proc_struct *proc);
+    // get the proc out runqueue, called with interrupts off
+    void (*dequeue)(struct run_queue *rq, struct proc_struct *proc);
+    // choose the next runnable task, which is left in the queue
+    struct proc_struct *(*pick_next)(struct run_queue *rq);
+    // dealer of the time-tick of the running proc
+    void (*proc_tick)(struct run_queue *rq, struct proc_struct *proc);
+    // the running proc gives the cpu away, before it is queued again if still
+    // runnable. may be NULL
+    void (*put_prev)(struct run_queue *rq, struct proc_struct *proc);
+};
+
+struct run_queue
+{
+    list_entry_t run_list;                 // the runnable processes, in the order of the class
+    unsigned int proc_num;                 // the number of them
+    int max_time_slice;                    // the time slice a process gets when queued
+    skew_heap_entry_t *run_pool;           // the runnable processes by pass, for the stride scheduler
+    uint32_t min_pass;                     // the pass of the process picked last, for the stride scheduler
+    struct rb_root cfs_tree;               // the runnable processes by vruntime, for the fair scheduler
+    struct rb_node *cfs_leftmost;          // the first of them, with the least vruntime
+    uint64_t cfs_load;                     // the sum of their weights
+    uint64_t min_vruntime;                 // never decreasing, where processes new or woken up start
+    list_entry_t mlfq_queues[MLFQ_LEVELS]; // the runnable processes by level, for the mlfq scheduler
+    unsigned int mlfq_len[MLFQ_LEVELS];    // the length of each queue
+    unsigned int mlfq_ticks;               // ticks since the last priority boost
+};
+
+void sched_init(void);
 void schedule(void);
 void wakeup_proc(struct proc_struct *proc);
+void sched_class_proc_tick(struct proc_struct *proc);
+void sched_dequeue(struct proc_struct *proc);
+void print_sched(void);
+void add_timer(timer_t *timer);
+void del_timer(timer_t *timer);
+void run_timer_list(void);
 
 #endif /* !__KERN_SCHEDULE_SCHED_H__ */
-
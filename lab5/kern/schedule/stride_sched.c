@@ -0,0 +1,120 @@
+#include <defs.h>
+#include <list.h>
+#include <proc.h>
+#include <assert.h>
+#include <unistd.h>
+#include <skew_heap.h>
+#include <stride_sched.h>
+
+/* *
+ * Stride scheduling: every process has a pass, and the runnable one with
+ * the least pass runs next, its pass then going up by its stride,
+ * BIG_STRIDE / priority. Over time each process runs in proportion to its
+ * priority. The run pool is a skew heap ordered by pass, so picking the
+ * next process and queueing one both take O(log n).
+ *
+ * BIG_STRIDE keeps the passes of runnable processes within 2^31 of each
+ * other, so they still compare right as signed differences once the
+ * uint32_t passes wrap around.
+ * */
+
+#define BIG_STRIDE 0x7FFFFFFF
+
+#define le2proc_pool(le) \
+    to_struct((le), struct proc_struct, run_pool)
+
+// proc_stride_comp_f - order of the run pool: by pass, as signed differences
+static int
+proc_stride_comp_f(void *a, void *b)
+{
+    struct proc_struct *p = le2proc_pool(a);
+    struct proc_struct *q = le2proc_pool(b);
+    int32_t c = p->pass - q->pass;
+    if (c > 0)
+    {
+        return 1;
+    }
+    else if (c == 0)
+    {
+        return 0;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+static void
+stride_init(struct run_queue *rq)
+{
+    list_init(&(rq->run_list));
+    rq->run_pool = NULL;
+    rq->proc_num = 0;
+    rq->min_pass = 0;
+}
+
+// stride_enqueue - queue proc in the run pool. a process new or woken up
+//                - starts no further behind than the one picked last, or
+//                - it would keep the cpu until it caught up
+static void
+stride_enqueue(struct run_queue *rq, struct proc_struct *proc)
+{
+    if ((int32_t)(proc->pass - rq->min_pass) < 0)
+    {
+        proc->pass = rq->min_pass;
+    }
+    rq->run_pool = skew_heap_insert(rq->run_pool, &(proc->run_pool), proc_stride_comp_f);
+    if (proc->time_slice == 0 || proc->time_slice > rq->max_time_slice)
+    {
+        proc->time_slice = rq->max_time_slice;
+    }
+    rq->proc_num++;
+}
+
+static void
+stride_dequeue(struct run_queue *rq, struct proc_struct *proc)
+{
+    assert(rq->proc_num > 0);
+    rq->run_pool = skew_heap_remove(rq->run_pool, &(proc->run_pool), proc_stride_comp_f);
+    rq->proc_num--;
+}
+
+// stride_pick_next - the process with the least pass, charged its stride
+//                  - for the turn it is about to get
+static struct proc_struct *
+stride_pick_next(struct run_queue *rq)
+{
+    if (rq->run_pool == NULL)
+    {
+        return NULL;
+    }
+    struct proc_struct *proc = le2proc_pool(rq->run_pool);
+    uint32_t priority = (proc->priority != 0) ? proc->priority : DEFAULT_PRIORITY;
+    rq->min_pass = proc->pass;
+    proc->pass += BIG_STRIDE / priority;
+    return proc;
+}
+
+// stride_proc_tick - charge a tick to the running proc, which gives the cpu
+//                  - away once its time slice is used up
+static void
+stride_proc_tick(struct run_queue *rq, struct proc_struct *proc)
+{
+    if (proc->time_slice > 0)
+    {
+        proc->time_slice--;
+    }
+    if (proc->time_slice == 0)
+    {
+        proc->need_resched = 1;
+    }
+}
+
+struct sched_class stride_sched_class = {
+    .name = "stride_scheduler",
+    .init = stride_init,
+    .enqueue = stride_enqueue,
+    .dequeue = stride_dequeue,
+    .pick_next = stride_pick_next,
+    .proc_tick = stride_proc_tick,
+};
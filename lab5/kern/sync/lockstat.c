@@ -0,0 +1,26 @@
+#include <defs.h>
+#include <list.h>
+#include <stdio.h>
+#include <lockstat.h>
+
+static list_entry_t lock_class_list = {&lock_class_list, &lock_class_list};
+
+// lock_class_register - make class known to print_lock_stats, once
+void lock_class_register(struct lock_class *class)
+{
+    if (class != NULL && class->class_link.next == NULL)
+    {
+        list_add_before(&lock_class_list, &(class->class_link));
+    }
+}
+
+void print_lock_stats(void)
+{
+    cprintf("%-16s %12s %12s %12s\n", "class", "acquisitions", "contended", "wait ticks");
+    list_entry_t *le = &lock_class_list;
+    while ((le = list_next(le)) != &lock_class_list)
+    {
+        struct lock_class *class = to_struct(le, struct lock_class, class_link);
+        cprintf("%-16s %12llu %12llu %12llu\n", class->name, class->acquisitions, class->contended, class->wait_ticks);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef __KERN_SYNC_LOCKSTAT_H__
+#define __KERN_SYNC_LOCKSTAT_H__
+
+#include <defs.h>
+#include <list.h>
+
+// the contention counters shared by all the mutexes or semaphores of one
+// kind, e.g. every mm_lock. a NULL class counts nothing
+struct lock_class
+{
+    const char *name;
+    size_t acquisitions;     // successful locks / downs
+    size_t contended;        // of those, the ones that had to sleep
+    size_t wait_ticks;       // clock ticks spent sleeping for them
+    list_entry_t class_link; // all the registered classes
+};
+
+#define DEFINE_LOCK_CLASS(var, cname) \
+    struct lock_class var = {.name = (cname)}
+
+void lock_class_register(struct lock_class *class);
+void print_lock_stats(void);
+
+// lockstat_acquired - count an acquisition, which slept since start if contended
+static inline void
+lockstat_acquired(struct lock_class *class, bool contended, size_t start)
+{
+    extern volatile size_t ticks;
+    if (class != NULL)
+    {
+        class->acquisitions++;
+        if (contended)
+        {
+            class->contended++;
+            class->wait_ticks += ticks - start;
+        }
+    }
+}
+
+#endif /* !__KERN_SYNC_LOCKSTAT_H__ */
@@ -0,0 +1,137 @@
+#include <defs.h>
+#include <wait.h>
+#include <sync.h>
+#include <proc.h>
+#include <sched.h>
+#include <clock.h>
+#include <kmalloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <lockstat.h>
+#include <sem.h>
+#include <mutex.h>
+
+void mutex_init(mutex_t *mutex, struct lock_class *class)
+{
+    mutex->owner = NULL;
+    wait_queue_init(&(mutex->wait_queue));
+    mutex->class = class;
+    lock_class_register(class);
+}
+
+bool mutex_trylock(mutex_t *mutex)
+{
+    bool intr_flag, ret = 0;
+    local_intr_save(intr_flag);
+    if (mutex->owner == NULL)
+    {
+        mutex->owner = current, ret = 1;
+    }
+    local_intr_restore(intr_flag);
+    if (ret)
+    {
+        lockstat_acquired(mutex->class, 0, 0);
+    }
+    return ret;
+}
+
+void mutex_lock(mutex_t *mutex)
+{
+    int spin;
+    for (spin = 0; spin < MUTEX_SPIN && mutex->owner != NULL && mutex->owner->state == PROC_RUNNABLE; spin++)
+    {
+        schedule();
+    }
+    if (mutex_trylock(mutex))
+    {
+        return;
+    }
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    assert(mutex->owner != current);
+    size_t start = ticks;
+    wait_t __wait, *wait = &__wait;
+    wait_current_set_exclusive(&(mutex->wait_queue), wait, WT_MUTEX);
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    local_intr_save(intr_flag);
+    wait_current_del(&(mutex->wait_queue), wait);
+    local_intr_restore(intr_flag);
+    // mutex_unlock made us the owner before waking us up
+    assert(mutex->owner == current);
+    lockstat_acquired(mutex->class, 1, start);
+}
+
+void mutex_unlock(mutex_t *mutex)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        assert(mutex->owner == current);
+        wait_t *wait;
+        if ((wait = wait_queue_first(&(mutex->wait_queue))) == NULL)
+        {
+            mutex->owner = NULL;
+        }
+        else
+        {
+            mutex->owner = wait->proc;
+            wakeup_wait(&(mutex->wait_queue), wait, WT_MUTEX, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+static DEFINE_LOCK_CLASS(check_lock_class, "check_mutex");
+
+// check_mutex - run by idleproc, another sleeper is faked as it cannot really sleep
+void check_mutex(void)
+{
+    struct proc_struct *proc = kmalloc(sizeof(struct proc_struct));
+    wait_t wait;
+    assert(proc != NULL);
+    // wakeup_proc queues it on the live run queue, which the class reads
+    memset(proc, 0, sizeof(struct proc_struct));
+    proc->priority = DEFAULT_PRIORITY;
+    list_init(&(proc->run_link));
+
+    // unlock hands the mutex over to the first sleeper
+    mutex_t mutex;
+    mutex_init(&mutex, &check_lock_class);
+    mutex_lock(&mutex);
+    assert(mutex.owner == current && !mutex_trylock(&mutex));
+    proc->state = PROC_SLEEPING, proc->wait_state = WT_MUTEX;
+    wait_init(&wait, proc);
+    wait_queue_add_exclusive(&(mutex.wait_queue), &wait);
+    mutex_unlock(&mutex);
+    assert(mutex.owner == proc && proc->state == PROC_RUNNABLE && !wait_in_queue(&wait));
+    assert(!mutex_trylock(&mutex));
+    sched_dequeue(proc);
+    mutex.owner = current;
+    mutex_unlock(&mutex);
+    assert(!mutex_is_locked(&mutex) && mutex_trylock(&mutex));
+    mutex_unlock(&mutex);
+
+    // up hands the unit over the same way
+    semaphore_t sem;
+    sem_init(&sem, 1, &check_lock_class);
+    down(&sem);
+    assert(sem.value == 0 && !try_down(&sem));
+    proc->state = PROC_SLEEPING, proc->wait_state = WT_SEM;
+    wait_init(&wait, proc);
+    wait_queue_add_exclusive(&(sem.wait_queue), &wait);
+    up(&sem);
+    assert(sem.value == 0 && proc->state == PROC_RUNNABLE && wait.wakeup_flags == WT_SEM);
+    up(&sem);
+    assert(sem.value == 1 && try_down(&sem));
+    sched_dequeue(proc);
+
+    assert(check_lock_class.acquisitions == 4 && check_lock_class.contended == 0);
+    kfree(proc);
+    cprintf("check_mutex() succeeded!\n");
+}
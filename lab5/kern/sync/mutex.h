@@ -0,0 +1,40 @@
+#ifndef __KERN_SYNC_MUTEX_H__
+#define __KERN_SYNC_MUTEX_H__
+
+#include <defs.h>
+#include <wait.h>
+
+struct proc_struct;
+struct lock_class;
+
+// before sleeping, mutex_lock yields up to MUTEX_SPIN times while the owner
+// is runnable and may be about to unlock. off by default: with one hart and
+// no kernel preemption an owner that sleeps holding the mutex is the only
+// way to contend, and then yielding does not help
+#ifndef MUTEX_SPIN
+#define MUTEX_SPIN 0
+#endif
+
+// a sleeping mutex. mutex_unlock with sleepers makes the first one the owner
+// before waking it up, so ownership goes in FIFO order without convoys
+typedef struct
+{
+    struct proc_struct *owner; // the holder, NULL if free
+    wait_queue_t wait_queue;   // the processes sleeping in mutex_lock
+    struct lock_class *class;  // contention counters, may be NULL
+} mutex_t;
+
+void mutex_init(mutex_t *mutex, struct lock_class *class);
+void mutex_lock(mutex_t *mutex);
+bool mutex_trylock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+static inline bool
+mutex_is_locked(mutex_t *mutex)
+{
+    return mutex->owner != NULL;
+}
+
+void check_mutex(void);
+
+#endif /* !__KERN_SYNC_MUTEX_H__ */
@@ -0,0 +1,78 @@
+#include <defs.h>
+#include <wait.h>
+#include <sync.h>
+#include <proc.h>
+#include <sched.h>
+#include <clock.h>
+#include <assert.h>
+#include <lockstat.h>
+#include <sem.h>
+
+void sem_init(semaphore_t *sem, int value, struct lock_class *class)
+{
+    sem->value = value;
+    wait_queue_init(&(sem->wait_queue));
+    sem->class = class;
+    lock_class_register(class);
+}
+
+void up(semaphore_t *sem)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        wait_t *wait;
+        if ((wait = wait_queue_first(&(sem->wait_queue))) == NULL)
+        {
+            sem->value++;
+        }
+        else
+        {
+            assert(wait->proc->wait_state == WT_SEM);
+            wakeup_wait(&(sem->wait_queue), wait, WT_SEM, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+void down(semaphore_t *sem)
+{
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    if (sem->value > 0)
+    {
+        sem->value--;
+        local_intr_restore(intr_flag);
+        lockstat_acquired(sem->class, 0, 0);
+        return;
+    }
+    size_t start = ticks;
+    wait_t __wait, *wait = &__wait;
+    wait_current_set_exclusive(&(sem->wait_queue), wait, WT_SEM);
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    local_intr_save(intr_flag);
+    wait_current_del(&(sem->wait_queue), wait);
+    local_intr_restore(intr_flag);
+    // the unit was handed over by up(), which is the only waker
+    assert(wait->wakeup_flags == WT_SEM);
+    lockstat_acquired(sem->class, 1, start);
+}
+
+bool try_down(semaphore_t *sem)
+{
+    bool intr_flag, ret = 0;
+    local_intr_save(intr_flag);
+    if (sem->value > 0)
+    {
+        sem->value--, ret = 1;
+    }
+    local_intr_restore(intr_flag);
+    if (ret)
+    {
+        lockstat_acquired(sem->class, 0, 0);
+    }
+    return ret;
+}
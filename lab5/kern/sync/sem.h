@@ -0,0 +1,23 @@
+#ifndef __KERN_SYNC_SEM_H__
+#define __KERN_SYNC_SEM_H__
+
+#include <defs.h>
+#include <wait.h>
+
+struct lock_class;
+
+// a counting semaphore. up() with sleepers hands the unit to the first one
+// instead of raising value, so a process coming late cannot take it first
+typedef struct
+{
+    int value;                 // units left, 0 while there are sleepers
+    wait_queue_t wait_queue;   // the processes sleeping in down()
+    struct lock_class *class;  // contention counters, may be NULL
+} semaphore_t;
+
+void sem_init(semaphore_t *sem, int value, struct lock_class *class);
+void up(semaphore_t *sem);
+void down(semaphore_t *sem);
+bool try_down(semaphore_t *sem);
+
+#endif /* !__KERN_SYNC_SEM_H__ */
@@ -0,0 +1,186 @@
+#include <defs.h>
+#include <list.h>
+#include <sync.h>
+#include <wait.h>
+#include <proc.h>
+#include <sched.h>
+#include <kmalloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+/* *
+ * Wait queues. A process blocks with wait_current_set, schedule and then
+ * wait_current_del, and is woken up by wakeup_first or wakeup_all on the
+ * same queue, which may take it out of the queue too (del).
+ *
+ * Exclusive waiters, e.g. those of a lock, are queued at the tail and plain
+ * ones at the head, so wakeup_all wakes every plain waiter and then only
+ * the first exclusive one: a single process gets what one of them can use.
+ * */
+
+void wait_init(wait_t *wait, struct proc_struct *proc)
+{
+    wait->proc = proc;
+    wait->wakeup_flags = 0;
+    wait->exclusive = 0;
+    wait->wait_queue = NULL;
+    list_init(&(wait->wait_link));
+}
+
+void wait_queue_init(wait_queue_t *queue)
+{
+    list_init(&(queue->wait_head));
+}
+
+void wait_queue_add(wait_queue_t *queue, wait_t *wait)
+{
+    assert(list_empty(&(wait->wait_link)) && wait->proc != NULL);
+    wait->wait_queue = queue;
+    wait->exclusive = 0;
+    list_add_after(&(queue->wait_head), &(wait->wait_link));
+}
+
+void wait_queue_add_exclusive(wait_queue_t *queue, wait_t *wait)
+{
+    assert(list_empty(&(wait->wait_link)) && wait->proc != NULL);
+    wait->wait_queue = queue;
+    wait->exclusive = 1;
+    list_add_before(&(queue->wait_head), &(wait->wait_link));
+}
+
+void wait_queue_del(wait_queue_t *queue, wait_t *wait)
+{
+    assert(!list_empty(&(wait->wait_link)) && wait->wait_queue == queue);
+    list_del_init(&(wait->wait_link));
+}
+
+wait_t *
+wait_queue_first(wait_queue_t *queue)
+{
+    list_entry_t *le = list_next(&(queue->wait_head));
+    if (le != &(queue->wait_head))
+    {
+        return le2wait(le, wait_link);
+    }
+    return NULL;
+}
+
+bool wait_queue_empty(wait_queue_t *queue)
+{
+    return list_empty(&(queue->wait_head));
+}
+
+bool wait_in_queue(wait_t *wait)
+{
+    return !list_empty(&(wait->wait_link));
+}
+
+// wakeup_wait - wake up the process of wait, a process already woken up
+//             - (e.g. by do_kill) is left alone
+void wakeup_wait(wait_queue_t *queue, wait_t *wait, uint32_t wakeup_flags, bool del)
+{
+    if (del)
+    {
+        wait_queue_del(queue, wait);
+    }
+    wait->wakeup_flags = wakeup_flags;
+    if (wait->proc->state != PROC_RUNNABLE)
+    {
+        wakeup_proc(wait->proc);
+    }
+}
+
+// wakeup_first - wake up the process at the head of queue, if any
+void wakeup_first(wait_queue_t *queue, uint32_t wakeup_flags, bool del)
+{
+    wait_t *wait;
+    if ((wait = wait_queue_first(queue)) != NULL)
+    {
+        wakeup_wait(queue, wait, wakeup_flags, del);
+    }
+}
+
+// wakeup_all - wake up the processes of queue, up to the first exclusive one
+void wakeup_all(wait_queue_t *queue, uint32_t wakeup_flags, bool del)
+{
+    list_entry_t *le = list_next(&(queue->wait_head));
+    while (le != &(queue->wait_head))
+    {
+        wait_t *wait = le2wait(le, wait_link);
+        le = list_next(le);
+        wakeup_wait(queue, wait, wakeup_flags, del);
+        if (wait->exclusive)
+        {
+            break;
+        }
+    }
+}
+
+// wait_current_set - put current to sleep in queue, the caller schedules next
+void wait_current_set(wait_queue_t *queue, wait_t *wait, uint32_t wait_state)
+{
+    assert(current != NULL);
+    wait_init(wait, current);
+    current->state = PROC_SLEEPING;
+    current->wait_state = wait_state;
+    wait_queue_add(queue, wait);
+}
+
+void wait_current_set_exclusive(wait_queue_t *queue, wait_t *wait, uint32_t wait_state)
+{
+    assert(current != NULL);
+    wait_init(wait, current);
+    current->state = PROC_SLEEPING;
+    current->wait_state = wait_state;
+    wait_queue_add_exclusive(queue, wait);
+}
+
+void check_wait_queue(void)
+{
+    struct proc_struct *procs = kmalloc(4 * sizeof(struct proc_struct));
+    wait_t waits[4];
+    wait_queue_t queue;
+    int i;
+    assert(procs != NULL);
+
+    // wakeup_proc queues them on the live run queue, which the class reads
+    memset(procs, 0, 4 * sizeof(struct proc_struct));
+    wait_queue_init(&queue);
+    for (i = 0; i < 4; i++)
+    {
+        procs[i].state = PROC_SLEEPING;
+        procs[i].priority = DEFAULT_PRIORITY;
+        list_init(&(procs[i].run_link));
+        wait_init(waits + i, procs + i);
+    }
+    wait_queue_add_exclusive(&queue, waits + 2);
+    wait_queue_add(&queue, waits + 0);
+    wait_queue_add_exclusive(&queue, waits + 3);
+    wait_queue_add(&queue, waits + 1);
+    assert(wait_queue_first(&queue) == waits + 1);
+
+    // every plain waiter and the first exclusive one
+    wakeup_all(&queue, 0x1, 1);
+    for (i = 0; i < 3; i++)
+    {
+        assert(procs[i].state == PROC_RUNNABLE && waits[i].wakeup_flags == 0x1 && !wait_in_queue(waits + i));
+    }
+    assert(procs[3].state == PROC_SLEEPING && wait_queue_first(&queue) == waits + 3);
+
+    // left in the queue unless del
+    wakeup_first(&queue, 0x2, 0);
+    assert(procs[3].state == PROC_RUNNABLE && waits[3].wakeup_flags == 0x2 && wait_in_queue(waits + 3));
+    wait_queue_del(&queue, waits + 3);
+    assert(wait_queue_empty(&queue));
+
+    // woken up, they were queued to run
+    for (i = 0; i < 4; i++)
+    {
+        assert(procs[i].rq != NULL);
+        sched_dequeue(procs + i);
+    }
+    kfree(procs);
+    cprintf("check_wait_queue() succeeded!\n");
+}
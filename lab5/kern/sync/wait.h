@@ -0,0 +1,56 @@
+#ifndef __KERN_SYNC_WAIT_H__
+#define __KERN_SYNC_WAIT_H__
+
+#include <defs.h>
+#include <list.h>
+
+// the processes sleeping for one event, woken up by whoever makes it happen
+typedef struct
+{
+    list_entry_t wait_head;
+} wait_queue_t;
+
+struct proc_struct;
+
+// a process in a wait queue, usually on the stack of the waiting process
+typedef struct
+{
+    struct proc_struct *proc; // the waiting process
+    uint32_t wakeup_flags;    // the reason it was woken up, 0 before that
+    bool exclusive;           // a wakeup_all stops after waking it up
+    wait_queue_t *wait_queue; // the queue it waits in
+    list_entry_t wait_link;   // the wait queue link
+} wait_t;
+
+#define le2wait(le, member) \
+    to_struct((le), wait_t, member)
+
+void wait_init(wait_t *wait, struct proc_struct *proc);
+void wait_queue_init(wait_queue_t *queue);
+void wait_queue_add(wait_queue_t *queue, wait_t *wait);
+void wait_queue_add_exclusive(wait_queue_t *queue, wait_t *wait);
+void wait_queue_del(wait_queue_t *queue, wait_t *wait);
+
+wait_t *wait_queue_first(wait_queue_t *queue);
+bool wait_queue_empty(wait_queue_t *queue);
+bool wait_in_queue(wait_t *wait);
+
+void wakeup_wait(wait_queue_t *queue, wait_t *wait, uint32_t wakeup_flags, bool del);
+void wakeup_first(wait_queue_t *queue, uint32_t wakeup_flags, bool del);
+void wakeup_all(wait_queue_t *queue, uint32_t wakeup_flags, bool del);
+
+void wait_current_set(wait_queue_t *queue, wait_t *wait, uint32_t wait_state);
+void wait_current_set_exclusive(wait_queue_t *queue, wait_t *wait, uint32_t wait_state);
+
+#define wait_current_del(queue, wait)       \
+    do                                      \
+    {                                       \
+        if (wait_in_queue(wait))            \
+        {                                   \
+            wait_queue_del(queue, wait);    \
+        }                                   \
+    } while (0)
+
+void check_wait_queue(void);
+
+#endif /* !__KERN_SYNC_WAIT_H__ */
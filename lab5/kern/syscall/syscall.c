@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <pmm.h>
 #include <assert.h>
+#include <clock.h>
 
 static int
 sys_exit(uint64_t arg[]) {
@@ -12,10 +13,32 @@ sys_exit(uint64_t arg[]) {
     return do_exit(error_code);
 }
 
+static int
+sys_exit_group(uint64_t arg[]) {
+    int error_code = (int)arg[0];
+    return do_exit_group(error_code);
+}
+
 static int sys_fork(uint64_t arg[]) {
     struct trapframe *tf = current->tf;
     uintptr_t stack = tf->gpr.sp;
-    return do_fork(CLONE_VM, stack, tf);
+    return do_fork(0, stack, tf);
+}
+
+static int
+sys_vfork(uint64_t arg[]) {
+    struct trapframe *tf = current->tf;
+    uintptr_t stack = tf->gpr.sp;
+    return do_fork(CLONE_VM | CLONE_VFORK, stack, tf);
+}
+
+static int
+sys_clone(uint64_t arg[]) {
+    uint32_t clone_flags = (uint32_t)arg[0];
+    uintptr_t stack = (uintptr_t)arg[1];
+    uintptr_t fn = (uintptr_t)arg[2];
+    uintptr_t fn_arg = (uintptr_t)arg[3];
+    return do_clone(clone_flags, stack, fn, fn_arg);
 }
 
 static int
@@ -27,11 +50,16 @@ sys_wait(uint64_t arg[]) {
 
 static int
 sys_exec(uint64_t arg[]) {
-    const char *name = (const char *)arg[0];
+    const char *path = (const char *)arg[0];
     size_t len = (size_t)arg[1];
-    unsigned char *binary = (unsigned char *)arg[2];
-    size_t size = (size_t)arg[3];
-    return do_execve(name, len, binary, size);
+    return do_execve(path, len);
+}
+
+static int
+sys_spawn(uint64_t arg[]) {
+    const char *path = (const char *)arg[0];
+    size_t len = (size_t)arg[1];
+    return do_spawn(path, len);
 }
 
 static int
@@ -39,12 +67,24 @@ sys_yield(uint64_t arg[]) {
     return do_yield();
 }
 
+static int
+sys_sleep(uint64_t arg[]) {
+    unsigned int time = (unsigned int)arg[0];
+    return do_sleep(time);
+}
+
 static int
 sys_kill(uint64_t arg[]) {
     int pid = (int)arg[0];
     return do_kill(pid);
 }
 
+static int
+sys_setpriority(uint64_t arg[]) {
+    uint32_t priority = (uint32_t)arg[0];
+    return do_setpriority(priority);
+}
+
 static int
 sys_getpid(uint64_t arg[]) {
     return current->pid;
@@ -63,14 +103,52 @@ sys_pgdir(uint64_t arg[]) {
     return 0;
 }
 
+static int
+sys_gettime(uint64_t arg[]) {
+    return (int)clock_gettime_msec();
+}
+
+static int
+sys_mmap(uint64_t arg[]) {
+    uintptr_t *addr_store = (uintptr_t *)arg[0];
+    size_t len = (size_t)arg[1];
+    uint32_t mmap_flags = (uint32_t)arg[2];
+    return do_mmap(addr_store, len, mmap_flags);
+}
+
+static int
+sys_munmap(uint64_t arg[]) {
+    uintptr_t addr = (uintptr_t)arg[0];
+    size_t len = (size_t)arg[1];
+    return do_munmap(addr, len);
+}
+
+static int
+sys_madvise(uint64_t arg[]) {
+    uintptr_t addr = (uintptr_t)arg[0];
+    size_t len = (size_t)arg[1];
+    int advice = (int)arg[2];
+    return do_madvise(addr, len, advice);
+}
+
 static int (*syscalls[])(uint64_t arg[]) = {
     [SYS_exit]              sys_exit,
     [SYS_fork]              sys_fork,
     [SYS_wait]              sys_wait,
     [SYS_exec]              sys_exec,
+    [SYS_vfork]             sys_vfork,
+    [SYS_spawn]             sys_spawn,
+    [SYS_exit_group]        sys_exit_group,
+    [SYS_clone]             sys_clone,
     [SYS_yield]             sys_yield,
+    [SYS_sleep]             sys_sleep,
     [SYS_kill]              sys_kill,
+    [SYS_setpriority]       sys_setpriority,
+    [SYS_gettime]           sys_gettime,
     [SYS_getpid]            sys_getpid,
+    [SYS_mmap]              sys_mmap,
+    [SYS_munmap]            sys_munmap,
+    [SYS_madvise]           sys_madvise,
     [SYS_putc]              sys_putc,
     [SYS_pgdir]             sys_pgdir,
 };
@@ -17,81 +17,10 @@
 #include <sbi.h>
 #include <pmm.h>
 #include <string.h>
+#include <uaccess.h>
 
 #define TICK_NUM 100
 
-static int do_pgfault(struct trapframe *tf) {
-    struct mm_struct *mm = current->mm;
-    if (mm == NULL) {
-        print_trapframe(tf);
-        panic("unhandled page fault: mm is NULL.\n");
-    }
-
-    uintptr_t addr = tf->tval;
-    pte_t *ptep = get_pte(mm->pgdir, addr, 0);
-
-    cprintf("[DEBUG do_pgfault] Page fault at addr 0x%x, ptep %p, *ptep 0x%x\n", addr, ptep, (ptep != NULL) ? *ptep : 0);
-
-    // 检查是否是 COW 相关的页错误
-    if (ptep != NULL && (*ptep & PTE_V) && !(*ptep & PTE_W) && (*ptep & PTE_COW)) {
-        cprintf("[DEBUG do_pgfault] COW fault detected.\n");
-        struct Page *page = pte2page(*ptep);
-        
-        // 如果页面被多个进程共享，则复制
-        if (page->ref > 1) {
-            cprintf("[DEBUG do_pgfault] Page ref > 1, copying page.\n");
-            struct Page *npage = alloc_page();
-            if (npage == NULL) {
-                cprintf("[DEBUG do_pgfault] Failed to allocate new page.\n");
-                goto fail; // 跳转到统一的失败处理
-            }
-            
-            void *kva_src = page2kva(page);
-            void *kva_dst = page2kva(npage);
-            memcpy(kva_dst, kva_src, PGSIZE);
-            
-            if (page_insert(mm->pgdir, npage, ROUNDDOWN(addr, PGSIZE), (*ptep & PTE_USER) | PTE_W) != 0) {
-                cprintf("[DEBUG do_pgfault] Failed to insert new page.\n");
-                free_page(npage);
-                goto fail; // 跳转到统一的失败处理
-            }
-            page_ref_dec(page);
-            cprintf("[DEBUG do_pgfault] COW handled successfully.\n");
-            return 0; // 成功处理，直接返回
-        } 
-        // 如果页面只被当前进程引用，直接设为可写
-        else if (page->ref == 1) {
-            cprintf("[DEBUG do_pgfault] Not COW: ptep=%p, PTE_V=%d, PTE_W=%d, PTE_COW=%d\n", ptep, (ptep != NULL && (*ptep & PTE_V)), (ptep != NULL && (*ptep & PTE_W)), (ptep != NULL && (*ptep & PTE_COW)));
-            if (page_insert(mm->pgdir, page, ROUNDDOWN(addr, PGSIZE), (*ptep & PTE_USER) | PTE_W) != 0) {
-                cprintf("[DEBUG do_pgfault] Failed to make writable.\n");
-                goto fail; // 跳转到统一的失败处理
-            }
-            cprintf("[DEBUG do_pgfault] Made writable successfully.\n");
-            return 0; // 成功处理，直接返回
-        }
-        else {
-            cprintf("[DEBUG do_pgfault] Page ref <= 1, making writable.\n");
-            if (page_insert(mm->pgdir, page, ROUNDDOWN(addr, PGSIZE), (*ptep & PTE_USER) | PTE_W) != 0) {
-                cprintf("[DEBUG do_pgfault] Failed to make writable.\n");
-                goto fail;
-            }
-            cprintf("[DEBUG do_pgfault] Made writable successfully.\n");
-            return 0;
-        }
-    }
-
-    // 如果不是 COW 页错误，或者处理失败，则执行到这里
-fail:
-    if (ptep == NULL) {
-        cprintf("[DEBUG do_pgfault] ptep is NULL.\n");
-    } else {
-        cprintf("[DEBUG do_pgfault] PTE check failed: V=%d, W=%d, COW=%d\n",
-                (*ptep & PTE_V) != 0, (*ptep & PTE_W) != 0, (*ptep & PTE_COW) != 0);
-    }
-    print_trapframe(tf);
-    panic("unhandled page fault.\n");
-}
-
 static void print_ticks()
 {
     cprintf("%d ticks\n", TICK_NUM);
@@ -110,8 +39,9 @@ void idt_init(void)
     write_csr(sscratch, 0);
     /* Set the exception vector address */
     write_csr(stvec, &__alltraps);
-    /* Allow kernel to access user memory */
-    set_csr(sstatus, SSTATUS_SUM);
+    /* Kernel may access user memory only through the uaccess routines,
+     * which set SSTATUS_SUM for the duration of the copy */
+    clear_csr(sstatus, SSTATUS_SUM);
 }
 
 /* trap_in_kernel - test if trap happened in kernel */
@@ -169,6 +99,37 @@ void print_regs(struct pushregs *gpr)
 
 extern struct mm_struct *check_mm_struct;
 
+// pgfault_handler - hand a page fault over to do_pgfault of the current mm
+static int pgfault_handler(struct trapframe *tf)
+{
+    if (current == NULL || current->mm == NULL)
+    {
+        if (search_exception_table(tf->epc) != 0)
+        {
+            return -E_FAULT;
+        }
+        print_trapframe(tf);
+        panic("unhandled page fault: mm is NULL.\n");
+    }
+    return do_pgfault(current->mm, tf->cause, tf->tval);
+}
+
+// search_exception_table - find the fixup address for a faulting instruction
+// return value: the fixup address, or 0 if the instruction may not fault
+uintptr_t search_exception_table(uintptr_t epc)
+{
+    extern struct exception_table_entry __start___ex_table[], __stop___ex_table[];
+    struct exception_table_entry *e;
+    for (e = __start___ex_table; e < __stop___ex_table; e++)
+    {
+        if (e->insn == epc)
+        {
+            return e->fixup;
+        }
+    }
+    return 0;
+}
+
 void interrupt_handler(struct trapframe *tf)
 {
     intptr_t cause = (tf->cause << 1) >> 1;
@@ -194,18 +155,15 @@ void interrupt_handler(struct trapframe *tf)
         /* 时间片轮转： 
         *(1) 设置下一次时钟中断（clock_set_next_event）
         *(2) ticks 计数器自增
-        *(3) 每 TICK_NUM 次中断（如 100 次），进行判断当前是否有进程正在运行，如果有则标记该进程需要被重新调度（current->need_resched）
+        *(3) 把这个 tick 记到当前进程上，时间片用完时 sched_class 会标记它需要被重新调度（current->need_resched）
         */
         clock_set_next_event();
 
-        static int ticks = 0;
-        
         ticks++;
+        run_timer_list();
 
-        if (ticks % TICK_NUM == 0) {
-            if (current != NULL) {
-                current->need_resched = 1;
-            }
+        if (current != NULL) {
+            sched_class_proc_tick(current);
         }
         break;
     case IRQ_H_TIMER:
@@ -286,9 +244,23 @@ void exception_handler(struct trapframe *tf)
     case CAUSE_FETCH_PAGE_FAULT:
     case CAUSE_LOAD_PAGE_FAULT:
     case CAUSE_STORE_PAGE_FAULT:
-        if (do_pgfault(tf) != 0) {
+        if ((ret = pgfault_handler(tf)) != 0)
+        {
+            if (trap_in_kernel(tf))
+            {
+                // a bad user pointer passed to copy_from_user/copy_to_user
+                uintptr_t fixup = search_exception_table(tf->epc);
+                if (fixup != 0)
+                {
+                    tf->epc = fixup;
+                    break;
+                }
+                print_trapframe(tf);
+                panic("handle pgfault failed in kernel mode. %e\n", ret);
+            }
             print_trapframe(tf);
-            panic("handle pgfault failed.\n");
+            cprintf("killed by kernel.\n");
+            do_exit(-E_KILLED);
         }
         break;
     default:
@@ -26,6 +26,7 @@ static inline void list_add_before(list_entry_t *listelm, list_entry_t *elm) __a
 static inline void list_add_after(list_entry_t *listelm, list_entry_t *elm) __attribute__((always_inline));
 static inline void list_del(list_entry_t *listelm) __attribute__((always_inline));
 static inline void list_del_init(list_entry_t *listelm) __attribute__((always_inline));
+static inline void list_splice(list_entry_t *list, list_entry_t *head) __attribute__((always_inline));
 static inline bool list_empty(list_entry_t *list) __attribute__((always_inline));
 static inline list_entry_t *list_next(list_entry_t *listelm) __attribute__((always_inline));
 static inline list_entry_t *list_prev(list_entry_t *listelm) __attribute__((always_inline));
@@ -105,6 +106,21 @@ list_del_init(list_entry_t *listelm) {
     list_init(listelm);
 }
 
+/* *
+ * list_splice - move all the entries of a list to the end of another
+ * @list:       the list whose entries are moved, left empty
+ * @head:       the list to add them to
+ * */
+static inline void
+list_splice(list_entry_t *list, list_entry_t *head) {
+    if (!list_empty(list)) {
+        list_entry_t *first = list->next, *last = list->prev, *tail = head->prev;
+        tail->next = first, first->prev = tail;
+        last->next = head, head->prev = last;
+        list_init(list);
+    }
+}
+
 /* *
  * list_empty - tests whether a list is empty
  * @list:       the list to test.
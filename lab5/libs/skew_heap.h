@@ -0,0 +1,119 @@
+#ifndef __LIBS_SKEW_HEAP_H__
+#define __LIBS_SKEW_HEAP_H__
+
+#include <defs.h>
+
+/* *
+ * Skew heap, a self-adjusting binary min-heap: merging two heaps walks down
+ * their right spines and swaps the children of every node on the way, so
+ * insert, remove and merge all take O(log n) amortized. The entries are
+ * embedded in the structures kept in the heap, like list_entry_t, and the
+ * order is the one of the compare function given to each operation.
+ * */
+
+struct skew_heap_entry {
+    struct skew_heap_entry *parent, *left, *right;
+};
+
+typedef struct skew_heap_entry skew_heap_entry_t;
+
+// compare_f - -1 if a comes before b, 0 if they are equal, 1 if it comes after
+typedef int(*compare_f)(void *a, void *b);
+
+static inline void skew_heap_init(skew_heap_entry_t *a) __attribute__((always_inline));
+static inline skew_heap_entry_t *skew_heap_merge(
+     skew_heap_entry_t *a, skew_heap_entry_t *b,
+     compare_f comp);
+static inline skew_heap_entry_t *skew_heap_insert(
+     skew_heap_entry_t *a, skew_heap_entry_t *b,
+     compare_f comp) __attribute__((always_inline));
+static inline skew_heap_entry_t *skew_heap_remove(
+     skew_heap_entry_t *a, skew_heap_entry_t *b,
+     compare_f comp) __attribute__((always_inline));
+
+/* *
+ * skew_heap_init - initialize an entry, a heap of its own
+ * */
+static inline void
+skew_heap_init(skew_heap_entry_t *a) {
+    a->left = a->right = a->parent = NULL;
+}
+
+/* *
+ * skew_heap_merge - merge the heaps a and b, either may be NULL
+ * return value: the root of the merged heap
+ * */
+static inline skew_heap_entry_t *
+skew_heap_merge(skew_heap_entry_t *a, skew_heap_entry_t *b,
+                compare_f comp) {
+    if (a == NULL) {
+        return b;
+    }
+    else if (b == NULL) {
+        return a;
+    }
+
+    skew_heap_entry_t *l, *r;
+    if (comp(a, b) == -1) {
+        r = a->left;
+        l = skew_heap_merge(a->right, b, comp);
+
+        a->left = l;
+        a->right = r;
+        if (l) {
+            l->parent = a;
+        }
+        return a;
+    }
+    else {
+        r = b->left;
+        l = skew_heap_merge(a, b->right, comp);
+
+        b->left = l;
+        b->right = r;
+        if (l) {
+            l->parent = b;
+        }
+        return b;
+    }
+}
+
+/* *
+ * skew_heap_insert - insert the entry b, not in any heap, into the heap a
+ * return value: the new root
+ * */
+static inline skew_heap_entry_t *
+skew_heap_insert(skew_heap_entry_t *a, skew_heap_entry_t *b,
+                 compare_f comp) {
+    skew_heap_init(b);
+    return skew_heap_merge(a, b, comp);
+}
+
+/* *
+ * skew_heap_remove - remove the entry b, anywhere in the heap a
+ * return value: the new root
+ * */
+static inline skew_heap_entry_t *
+skew_heap_remove(skew_heap_entry_t *a, skew_heap_entry_t *b,
+                 compare_f comp) {
+    skew_heap_entry_t *p = b->parent;
+    skew_heap_entry_t *rep = skew_heap_merge(b->left, b->right, comp);
+    if (rep) {
+        rep->parent = p;
+    }
+
+    if (p) {
+        if (p->left == b) {
+            p->left = rep;
+        }
+        else {
+            p->right = rep;
+        }
+        return a;
+    }
+    else {
+        return rep;
+    }
+}
+
+#endif /* !__LIBS_SKEW_HEAP_H__ */
@@ -9,21 +9,40 @@
 #define SYS_wait            3
 #define SYS_exec            4
 #define SYS_clone           5
+#define SYS_vfork           6
+#define SYS_spawn           7
+#define SYS_exit_group      8
 #define SYS_yield           10
 #define SYS_sleep           11
 #define SYS_kill            12
+#define SYS_setpriority     13
 #define SYS_gettime         17
 #define SYS_getpid          18
 #define SYS_brk             19
 #define SYS_mmap            20
 #define SYS_munmap          21
 #define SYS_shmem           22
+#define SYS_madvise         23
 #define SYS_putc            30
 #define SYS_pgdir           31
 
 /* SYS_fork flags */
 #define CLONE_VM            0x00000100  // set if VM shared between processes
-#define CLONE_THREAD        0x00000200  // thread group
+#define CLONE_THREAD        0x00000200  // thread group, needs CLONE_VM
+#define CLONE_VFORK         0x00004000  // parent sleeps until the child execs or exits
+
+/* SYS_mmap flags */
+#define MMAP_WRITE          0x00000100  // the mapping is writable
+#define MMAP_SHARED         0x00000400  // the mapping is shared with forked children
+
+/* SYS_madvise advice, how many neighbours a page fault resolves too */
+#define MADV_NORMAL         0           // the default
+#define MADV_RANDOM         1           // none
+#define MADV_SEQUENTIAL     2           // as many as possible
+
+/* SYS_setpriority priorities, the share of the cpu: twice the priority, twice the share */
+#define DEFAULT_PRIORITY    1           // of a new process
+#define MAX_PRIORITY        1024
 
 #endif /* !__LIBS_UNISTD_H__ */
 
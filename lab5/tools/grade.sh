@@ -336,12 +336,31 @@ default_check() {
 
     pts=3
     quick_check 'check output'                                  \
+    'check_trace() succeeded!'                                  \
     'memory management: default_pmm_manager'                      \
     'check_alloc_page() succeeded!'                             \
     'check_pgdir() succeeded!'                                  \
     'check_boot_pgdir() succeeded!'				\
     'check_vma_struct() succeeded!'                             \
+    'check_stack_growth() succeeded!'                           \
+    'check_vma_merge_split() succeeded!'                        \
+    'check_pt_share() succeeded!'                               \
+    'check_fault_around() succeeded!'                           \
+    'check_zero_page() succeeded!'                              \
+    'check_ksm() succeeded!'                                    \
+    'check_mm_recycle() succeeded!'                             \
     'check_vmm() succeeded.'					\
+    'check_initrd() succeeded!'                                 \
+    'check_sched_class() succeeded!'                            \
+    'check_cfs_sched() succeeded!'                              \
+    'check_mlfq_sched() succeeded!'                             \
+    'check_wait_queue() succeeded!'                             \
+    'check_pid() succeeded!'                                    \
+    'check_kstack() succeeded!'                                 \
+    'check_workqueue() succeeded!'                              \
+    'check_mm_reap() succeeded!'                                \
+    'check_mutex() succeeded!'                                  \
+    'check_template() succeeded!'                               \
     '++ setup timer interrupts'
 }
 
@@ -455,6 +474,110 @@ run_test -prog 'forktest'   -check default_check
     !   'wait got too many'                                     \
     ! - 'user panic at .*'
 
+run_test -prog 'deepstack'  -check default_check                                     \
+        'kernel_execve: pid = 2, name = "deepstack".'           \
+        'deepstack pass.'                                       \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'shmemtest'  -check default_check                                     \
+        'kernel_execve: pid = 2, name = "shmemtest".'           \
+        'shmemtest pass.'                                       \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'forkbench'  -check default_check                                     \
+        'kernel_execve: pid = 2, name = "forkbench".'           \
+        'forkbench pass.'                                       \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'vforktest'  -check default_check                                     \
+        'kernel_execve: pid = 2, name = "vforktest".'           \
+        'vforktest pass.'                                       \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'ksmtest'  -check default_check                                       \
+        'kernel_execve: pid = 2, name = "ksmtest".'             \
+        'ksmtest pass.'                                         \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'reaptest'  -check default_check                                      \
+        'kernel_execve: pid = 2, name = "reaptest".'            \
+        'reaptest pass.'                                        \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -tag 'reaptest sync' -prog 'reaptest' -DMM_REAP_ASYNC=0 -check default_check \
+        'kernel_execve: pid = 2, name = "reaptest".'            \
+        'reaptest pass.'                                        \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'spawntest'  -check default_check                                     \
+        'kernel_execve: pid = 2, name = "spawntest".'           \
+        'Hello world!!.'                                        \
+        'hello pass.'                                           \
+        'yield pass.'                                           \
+        'spawntest pass.'                                       \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'threadtest'  -check default_check                                    \
+        'kernel_execve: pid = 2, name = "threadtest".'          \
+        'threadtest: 8 threads joined.'                         \
+        'threadtest: group exit.'                               \
+        'threadtest pass.'                                      \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'execbench'  -check default_check                                     \
+        'kernel_execve: pid = 2, name = "execbench".'           \
+        'execbench pass.'                                       \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -tag 'execbench norecycle' -prog 'execbench' -DEXEC_RECYCLE=0 -check default_check \
+        'kernel_execve: pid = 2, name = "execbench".'           \
+        'execbench pass.'                                       \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -prog 'priority'  -check default_check                                      \
+        'kernel_execve: pid = 2, name = "priority".'            \
+        'priority pass.'                                        \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -tag 'priority cfs' -prog 'priority' -DSCHED_POLICY=2 -check default_check  \
+        'kernel_execve: pid = 2, name = "priority".'            \
+        'sched class: CFS_scheduler'                            \
+        'priority pass.'                                        \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
+
+run_test -tag 'latency mlfq' -prog 'latency' -DSCHED_POLICY=3 -check default_check  \
+        'kernel_execve: pid = 2, name = "latency".'             \
+        'sched class: MLFQ_scheduler'                           \
+        'latency pass.'                                         \
+        'all user-mode processes have quit.'                    \
+        'init check memory pass.'                               \
+    ! - 'user panic at .*'
 
 ## print final-score
 show_final
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/* *
+ * mkinitrd - pack files into an initrd image for kern/fs/initrd.c
+ * usage: mkinitrd <output> <name>=<file> ...
+ * the format is defined in kern/fs/initrd.h, repeated here for the host.
+ * */
+
+#define INITRD_MAGIC        0x44525449
+#define INITRD_NAME_LEN     31
+#define INITRD_ALIGN        8
+#define INITRD_NONE         0xffffffff
+
+struct initrd_header {
+    uint32_t magic;
+    uint32_t nr_files;
+    uint32_t nr_buckets;
+    uint32_t size;
+};
+
+struct initrd_entry {
+    char name[INITRD_NAME_LEN + 1];
+    uint32_t offset;
+    uint32_t size;
+    uint32_t hash;
+    uint32_t next;
+};
+
+static uint32_t
+initrd_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name != '\0') {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+int
+main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: <output filename> <name>=<input filename> ...\n");
+        return -1;
+    }
+    uint32_t nr_files = argc - 2, nr_buckets = 16, i, j;
+    while (nr_buckets < 2 * nr_files) {
+        nr_buckets *= 2;
+    }
+
+    struct initrd_header header = {INITRD_MAGIC, nr_files, nr_buckets, 0};
+    uint32_t *buckets = malloc(nr_buckets * sizeof(uint32_t));
+    struct initrd_entry *entries = calloc(nr_files, sizeof(struct initrd_entry));
+    char **paths = malloc(nr_files * sizeof(char *));
+    if (buckets == NULL || entries == NULL || paths == NULL) {
+        fprintf(stderr, "out of memory.\n");
+        return -1;
+    }
+    memset(buckets, 0xff, nr_buckets * sizeof(uint32_t));
+
+    uint32_t offset = sizeof(header) + nr_buckets * sizeof(uint32_t) + nr_files * sizeof(struct initrd_entry);
+    for (i = 0; i < nr_files; i ++) {
+        char *name = argv[i + 2], *path = strchr(name, '=');
+        struct stat st;
+        if (path == NULL || path == name || path - name > INITRD_NAME_LEN) {
+            fprintf(stderr, "bad argument '%s', a name of 1 to %d chars is needed.\n", name, INITRD_NAME_LEN);
+            return -1;
+        }
+        *path ++ = '\0';
+        if (stat(path, &st) != 0) {
+            fprintf(stderr, "Error opening file '%s': %s\n", path, strerror(errno));
+            return -1;
+        }
+        for (j = 0; j < i; j ++) {
+            if (strcmp(entries[j].name, name) == 0) {
+                fprintf(stderr, "duplicate name '%s'.\n", name);
+                return -1;
+            }
+        }
+        struct initrd_entry *entry = entries + i;
+        strcpy(entry->name, name);
+        offset = (offset + INITRD_ALIGN - 1) / INITRD_ALIGN * INITRD_ALIGN;
+        entry->offset = offset, entry->size = st.st_size;
+        entry->hash = initrd_hash(name);
+        entry->next = buckets[entry->hash & (nr_buckets - 1)];
+        buckets[entry->hash & (nr_buckets - 1)] = i;
+        paths[i] = path;
+        offset += st.st_size;
+    }
+    header.size = offset;
+
+    FILE *ofp = fopen(argv[1], "wb+");
+    if (ofp == NULL) {
+        fprintf(stderr, "Error opening file '%s': %s\n", argv[1], strerror(errno));
+        return -1;
+    }
+    fwrite(&header, sizeof(header), 1, ofp);
+    fwrite(buckets, sizeof(uint32_t), nr_buckets, ofp);
+    fwrite(entries, sizeof(struct initrd_entry), nr_files, ofp);
+    for (i = 0; i < nr_files; i ++) {
+        FILE *ifp = fopen(paths[i], "rb");
+        char buf[4096];
+        size_t size;
+        if (ifp == NULL) {
+            fprintf(stderr, "Error opening file '%s': %s\n", paths[i], strerror(errno));
+            return -1;
+        }
+        while (ftell(ofp) < entries[i].offset) {
+            fputc(0, ofp);
+        }
+        while ((size = fread(buf, 1, sizeof(buf), ifp)) > 0) {
+            fwrite(buf, 1, size, ofp);
+        }
+        fclose(ifp);
+    }
+    if (ftell(ofp) != header.size) {
+        fprintf(stderr, "write '%s' error, size is %ld.\n", argv[1], ftell(ofp));
+        return -1;
+    }
+    fclose(ofp);
+    printf("build initrd '%s': %u files, %u bytes\n", argv[1], nr_files, header.size);
+    return 0;
+}
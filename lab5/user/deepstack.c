@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <ulib.h>
+
+#define FRAME_SIZE  1024
+#define DEPTH       64
+
+/* each level keeps FRAME_SIZE bytes live on the stack, so DEPTH levels need
+ * far more than the single stack page mapped by exec */
+static int
+recurse(int depth) {
+    volatile char frame[FRAME_SIZE];
+    int i, sum = 0;
+    for (i = 0; i < FRAME_SIZE; i ++) {
+        frame[i] = (char)(depth + i);
+    }
+    if (depth > 0) {
+        sum = recurse(depth - 1);
+    }
+    for (i = 0; i < FRAME_SIZE; i ++) {
+        if (frame[i] != (char)(depth + i)) {
+            panic("frame %d corrupted at %d\n", depth, i);
+        }
+    }
+    return sum + 1;
+}
+
+int
+main(void) {
+    cprintf("deepstack: recursing %d levels of %d bytes.\n", DEPTH, FRAME_SIZE);
+    assert(recurse(DEPTH - 1) == DEPTH);
+    cprintf("deepstack pass.\n");
+    return 0;
+}
+
@@ -0,0 +1,38 @@
+#include <ulib.h>
+#include <stdio.h>
+
+#define NEXEC       64
+
+/* *
+ * exec latency: NEXEC children fork and exec a program doing nothing, next
+ * to NEXEC children that only fork and exit. The difference is what exec
+ * costs; built with EXEC_RECYCLE=0 the kernel frees the old mm on every
+ * exec and builds a new one instead of emptying and reusing it.
+ * */
+int
+main(void) {
+    int i, pid, code;
+
+    unsigned int start = gettime_msec();
+    for (i = 0; i < NEXEC; i ++) {
+        if ((pid = fork()) == 0) {
+            exit(0);
+        }
+        assert(pid > 0 && waitpid(pid, &code) == 0 && code == 0);
+    }
+    unsigned int fork_ms = gettime_msec() - start;
+
+    start = gettime_msec();
+    for (i = 0; i < NEXEC; i ++) {
+        if ((pid = fork()) == 0) {
+            exec("true");
+            panic("exec true failed.\n");
+        }
+        assert(pid > 0 && waitpid(pid, &code) == 0 && code == 0);
+    }
+    unsigned int exec_ms = gettime_msec() - start;
+
+    cprintf("execbench: %d fork+exit in %d ms, %d fork+exec in %d ms\n", NEXEC, fork_ms, NEXEC, exec_ms);
+    cprintf("execbench pass.\n");
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define PGSIZE      4096
+#define MB          (1024 * 1024)
+#define NFORK       8
+
+/* *
+ * fork latency against the amount of touched memory. With PTs shared at fork
+ * the time should stay nearly flat instead of growing with the mapped size.
+ * 64 MB is about the most the 128 MB board can back twice over.
+ * */
+static const int sizes[] = {1, 4, 16, 64};
+
+int
+main(void) {
+    int i, n, pid, exit_code;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i ++) {
+        size_t len = sizes[i] * MB;
+        char *buf = mmap(NULL, len, MMAP_WRITE);
+        assert(buf != NULL);
+        size_t off;
+        for (off = 0; off < len; off += PGSIZE) {
+            buf[off] = (char)(off / PGSIZE);
+        }
+
+        unsigned int start = gettime_msec();
+        for (n = 0; n < NFORK; n ++) {
+            if ((pid = fork()) == 0) {
+                exit(0);
+            }
+            assert(pid > 0 && waitpid(pid, &exit_code) == 0);
+        }
+        unsigned int elapsed = gettime_msec() - start;
+        cprintf("forkbench: %d MB mapped, %d forks in %d ms\n", sizes[i], NFORK, elapsed);
+
+        // writes after fork still stay private to each side
+        if ((pid = fork()) == 0) {
+            for (off = 0; off < len; off += 16 * PGSIZE) {
+                assert(buf[off] == (char)(off / PGSIZE));
+                buf[off] = -1;
+            }
+            exit(0);
+        }
+        assert(pid > 0 && waitpid(pid, &exit_code) == 0 && exit_code == 0);
+        for (off = 0; off < len; off += PGSIZE) {
+            assert(buf[off] == (char)(off / PGSIZE));
+        }
+        assert(munmap(buf, len) == 0);
+    }
+    cprintf("forkbench pass.\n");
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define PAGES       16
+#define PGSIZE      4096
+#define WORDS       (PAGES * PGSIZE / sizeof(int))
+#define NWORKER     4
+
+static void
+build(int *table, int seed) {
+    int i;
+    for (i = 0; i < WORDS; i ++) {
+        table[i] = i * 7 + seed;
+    }
+}
+
+static void
+verify(int *table, int seed) {
+    int i;
+    for (i = 0; i < WORDS; i ++) {
+        assert(table[i] == i * 7 + seed);
+    }
+}
+
+// each worker rebuilds the table it inherited, so all of them hold private
+// copies with the same contents for ksmd to merge while they sleep. merging
+// must not be visible: the contents stay, and writes stay private
+int
+main(void) {
+    int *table = mmap(NULL, PAGES * PGSIZE, MMAP_WRITE);
+    assert(table != NULL);
+    build(table, 1);
+
+    int i, pid, exit_code;
+    for (i = 0; i < NWORKER; i ++) {
+        if ((pid = fork()) == 0) {
+            build(table, 1);
+            sleep(30);
+            verify(table, 1);
+            build(table, i + 2);
+            sleep(10);
+            verify(table, i + 2);
+            exit(0);
+        }
+        assert(pid > 0);
+    }
+
+    sleep(20);
+    verify(table, 1);
+    for (i = 0; i < NWORKER; i ++) {
+        assert(waitpid(0, &exit_code) == 0 && exit_code == 0);
+    }
+    verify(table, 1);
+    assert(munmap(table, PAGES * PGSIZE) == 0);
+    cprintf("ksmtest pass.\n");
+    return 0;
+}
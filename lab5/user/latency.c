@@ -0,0 +1,44 @@
+#include <ulib.h>
+#include <stdio.h>
+
+#define NHOG        2
+#define NSLEEP      50
+#define TICK_MS     10
+
+/* *
+ * interactive latency next to CPU bound jobs: the parent sleeps one tick at
+ * a time while NHOG children spin, and has to be back running soon after
+ * each tick rather than queued behind the spinners. the MLFQ scheduler
+ * keeps it at the top level while the spinners sink to the bottom one.
+ * */
+int
+main(void) {
+    int i, pids[NHOG];
+    for (i = 0; i < NHOG; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            while (1);
+        }
+        assert(pids[i] > 0);
+    }
+
+    // the spinners use up their quanta meanwhile
+    sleep(10);
+
+    unsigned int total = 0, worst = 0;
+    for (i = 0; i < NSLEEP; i ++) {
+        unsigned int start = gettime_msec();
+        sleep(1);
+        unsigned int elapsed = gettime_msec() - start;
+        total += elapsed;
+        worst = (elapsed > worst) ? elapsed : worst;
+    }
+    cprintf("latency: %d sleeps of a tick next to %d spinners, %d ms on average, %d ms at worst\n",
+            NSLEEP, NHOG, total / NSLEEP, worst);
+
+    for (i = 0; i < NHOG; i ++) {
+        assert(kill(pids[i]) == 0 && waitpid(pids[i], NULL) == 0);
+    }
+    assert(total / NSLEEP <= 2 * TICK_MS);
+    cprintf("latency pass.\n");
+    return 0;
+}
@@ -36,6 +36,16 @@ sys_exit(int64_t error_code) {
     return syscall(SYS_exit, error_code);
 }
 
+int
+sys_exit_group(int64_t error_code) {
+    return syscall(SYS_exit_group, error_code);
+}
+
+int
+sys_clone(uint32_t clone_flags, uintptr_t stack, uintptr_t fn, uintptr_t arg) {
+    return syscall(SYS_clone, clone_flags, stack, fn, arg);
+}
+
 int
 sys_fork(void) {
     return syscall(SYS_fork);
@@ -46,6 +56,16 @@ sys_wait(int64_t pid, int *store) {
     return syscall(SYS_wait, pid, store);
 }
 
+int
+sys_exec(const char *path, size_t len) {
+    return syscall(SYS_exec, path, len);
+}
+
+int
+sys_spawn(const char *path, size_t len) {
+    return syscall(SYS_spawn, path, len);
+}
+
 int
 sys_yield(void) {
     return syscall(SYS_yield);
@@ -56,6 +76,11 @@ sys_kill(int64_t pid) {
     return syscall(SYS_kill, pid);
 }
 
+int
+sys_setpriority(uint32_t priority) {
+    return syscall(SYS_setpriority, priority);
+}
+
 int
 sys_getpid(void) {
     return syscall(SYS_getpid);
@@ -71,3 +96,27 @@ sys_pgdir(void) {
     return syscall(SYS_pgdir);
 }
 
+int
+sys_sleep(uint64_t time) {
+    return syscall(SYS_sleep, time);
+}
+
+int
+sys_gettime(void) {
+    return syscall(SYS_gettime);
+}
+
+int
+sys_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
+    return syscall(SYS_mmap, addr_store, len, mmap_flags);
+}
+
+int
+sys_munmap(uintptr_t addr, size_t len) {
+    return syscall(SYS_munmap, addr, len);
+}
+
+int
+sys_madvise(uintptr_t addr, size_t len, int advice) {
+    return syscall(SYS_madvise, addr, len, advice);
+}
@@ -2,13 +2,23 @@
 #define __USER_LIBS_SYSCALL_H__
 
 int sys_exit(int64_t error_code);
+int sys_exit_group(int64_t error_code);
+int sys_clone(uint32_t clone_flags, uintptr_t stack, uintptr_t fn, uintptr_t arg);
 int sys_fork(void);
 int sys_wait(int64_t pid, int *store);
+int sys_exec(const char *path, size_t len);
+int sys_spawn(const char *path, size_t len);
 int sys_yield(void);
+int sys_sleep(uint64_t time);
 int sys_kill(int64_t pid);
+int sys_setpriority(uint32_t priority);
 int sys_getpid(void);
 int sys_putc(int64_t c);
 int sys_pgdir(void);
+int sys_gettime(void);
+int sys_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
+int sys_munmap(uintptr_t addr, size_t len);
+int sys_madvise(uintptr_t addr, size_t len, int advice);
 
 #endif /* !__USER_LIBS_SYSCALL_H__ */
 
@@ -0,0 +1,61 @@
+#include <defs.h>
+#include <unistd.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <ulib.h>
+#include <error.h>
+#include <thread.h>
+
+// what a new thread runs, at the top of its stack
+struct thread_start {
+    int (*fn)(void *);
+    void *arg;
+};
+
+// thread_entry - the first function of a thread, sys_clone starts it with
+// a0 pointing at its thread_start. it has no caller to return to
+static void __attribute__((noreturn))
+thread_entry(struct thread_start *start) {
+    thread_exit(start->fn(start->arg));
+}
+
+// thread - create a thread running fn(arg) on a stack of its own
+// return value: 0 with the thread in *tidp, or an error
+int
+thread(int (*fn)(void *), void *arg, thread_t *tidp) {
+    void *stack;
+    if ((stack = mmap(NULL, THREAD_STACKSIZE, MMAP_WRITE)) == NULL) {
+        return -E_NO_MEM;
+    }
+    struct thread_start *start = (struct thread_start *)((uintptr_t)stack + THREAD_STACKSIZE) - 1;
+    start->fn = fn, start->arg = arg;
+    uintptr_t sp = ROUNDDOWN((uintptr_t)start, 16);
+
+    int pid = sys_clone(CLONE_VM | CLONE_THREAD, sp, (uintptr_t)thread_entry, (uintptr_t)start);
+    if (pid <= 0) {
+        munmap(stack, THREAD_STACKSIZE);
+        return pid < 0 ? pid : -E_INVAL;
+    }
+    tidp->pid = pid, tidp->stack = stack;
+    return 0;
+}
+
+// thread_wait - wait for a thread to exit and free its stack
+int
+thread_wait(thread_t *tidp, int *exit_code) {
+    int ret;
+    if ((ret = waitpid(tidp->pid, exit_code)) == 0) {
+        munmap(tidp->stack, THREAD_STACKSIZE);
+        tidp->pid = 0, tidp->stack = NULL;
+    }
+    return ret;
+}
+
+// thread_exit - exit the calling thread only, unlike exit
+void
+thread_exit(int exit_code) {
+    sys_exit(exit_code);
+    cprintf("BUG: thread_exit failed.\n");
+    while (1);
+}
+
@@ -0,0 +1,21 @@
+#ifndef __USER_LIBS_THREAD_H__
+#define __USER_LIBS_THREAD_H__
+
+#include <defs.h>
+
+#define THREAD_STACKSIZE        (4096 * 4)
+
+// a thread shares the memory of the process and exits with it, it is a
+// child of the thread that created it, which joins it with thread_wait.
+// kill(pid) of any thread kills the whole process
+typedef struct {
+    int pid;
+    void *stack;
+} thread_t;
+
+int thread(int (*fn)(void *), void *arg, thread_t *tidp);
+int thread_wait(thread_t *tidp, int *exit_code);
+void thread_exit(int exit_code) __attribute__((noreturn));
+
+#endif /* !__USER_LIBS_THREAD_H__ */
+
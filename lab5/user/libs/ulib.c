@@ -2,10 +2,12 @@
 #include <syscall.h>
 #include <stdio.h>
 #include <ulib.h>
+#include <string.h>
 
+// exit - exit the process, the other threads of it too
 void
 exit(int error_code) {
-    sys_exit(error_code);
+    sys_exit_group(error_code);
     cprintf("BUG: exit failed.\n");
     while (1);
 }
@@ -25,6 +27,19 @@ waitpid(int pid, int *store) {
     return sys_wait(pid, store);
 }
 
+// exec - run the program at path in the initrd instead, returns only on error
+int
+exec(const char *path) {
+    return sys_exec(path, strlen(path));
+}
+
+// spawn - start the program at path in the initrd in a new child process
+// return value: the pid of the child, or an error
+int
+spawn(const char *path) {
+    return sys_spawn(path, strlen(path));
+}
+
 void
 yield(void) {
     sys_yield();
@@ -46,3 +61,41 @@ print_pgdir(void) {
     sys_pgdir();
 }
 
+unsigned int
+gettime_msec(void) {
+    return (unsigned int)sys_gettime();
+}
+
+// sleep - sleep for time clock ticks
+int
+sleep(unsigned int time) {
+    return sys_sleep(time);
+}
+
+// setpriority - set the share of the cpu the process gets, from 1 to
+//             - MAX_PRIORITY: twice the priority, twice the share
+int
+setpriority(uint32_t priority) {
+    return sys_setpriority(priority);
+}
+
+// mmap - map len bytes of zeroed memory at addr (NULL to let the kernel choose)
+// return value: the mapped address, or NULL on failure
+void *
+mmap(void *addr, size_t len, uint32_t mmap_flags) {
+    uintptr_t va = (uintptr_t)addr;
+    if (sys_mmap(&va, len, mmap_flags) != 0) {
+        return NULL;
+    }
+    return (void *)va;
+}
+
+int
+munmap(void *addr, size_t len) {
+    return sys_munmap((uintptr_t)addr, len);
+}
+
+int
+madvise(void *addr, size_t len, int advice) {
+    return sys_madvise((uintptr_t)addr, len, advice);
+}
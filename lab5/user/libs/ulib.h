@@ -25,12 +25,21 @@ void __noreturn __panic(const char *file, int line, const char *fmt, ...);
 
 void __noreturn exit(int error_code);
 int fork(void);
+int vfork(void) __attribute__((returns_twice));
 int wait(void);
 int waitpid(int pid, int *store);
+int exec(const char *path);
+int spawn(const char *path);
 void yield(void);
 int kill(int pid);
 int getpid(void);
 void print_pgdir(void);
+unsigned int gettime_msec(void);
+int sleep(unsigned int time);
+int setpriority(uint32_t priority);
+void *mmap(void *addr, size_t len, uint32_t mmap_flags);
+int munmap(void *addr, size_t len);
+int madvise(void *addr, size_t len, int advice);
 
 #endif /* !__USER_LIBS_ULIB_H__ */
 
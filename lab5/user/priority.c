@@ -0,0 +1,58 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define NCHILD      3
+#define WARMUP      200     // ms for every child to be forked and spinning
+#define DURATION    4000    // ms the children count their loops for
+#define LOOPS       1000    // loops counted as one unit of work
+
+/* *
+ * scheduling fairness: children of priority 1, 2 and 4 spin over the same
+ * window of time, and the work each one gets done has to follow the share
+ * of the cpu its priority asks for, within 25%. the priority is the ticket
+ * count of the stride scheduler (stride = BIG_STRIDE / priority) and the
+ * weight of CFS
+ * */
+static const int priorities[NCHILD] = {1, 2, 4};
+
+static volatile int sink;
+
+int
+main(void) {
+    int i, pid, pids[NCHILD], acc[NCHILD];
+
+    assert(setpriority(0) != 0 && setpriority(MAX_PRIORITY + 1) != 0);
+
+    unsigned int start = gettime_msec() + WARMUP, end = start + DURATION;
+    for (i = 0; i < NCHILD; i ++) {
+        if ((pid = fork()) == 0) {
+            assert(setpriority(priorities[i]) == 0);
+            while (gettime_msec() < start) {
+                sink ++;
+            }
+            int units = 0, n;
+            while (gettime_msec() < end) {
+                for (n = 0; n < LOOPS; n ++) {
+                    sink ++;
+                }
+                units ++;
+            }
+            exit(units);
+        }
+        assert(pid > 0);
+        pids[i] = pid;
+    }
+    for (i = 0; i < NCHILD; i ++) {
+        assert(waitpid(pids[i], &acc[i]) == 0 && acc[i] > 0);
+    }
+
+    for (i = 0; i < NCHILD; i ++) {
+        int share = acc[i] * 100 / acc[0], want = priorities[i] * 100 / priorities[0];
+        cprintf("priority: child %d, priority %d, %d units, %d%% of the first\n",
+                i, priorities[i], acc[i], share);
+        assert(share * 4 >= want * 3 && share * 4 <= want * 5);
+    }
+    cprintf("priority pass.\n");
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <ulib.h>
+#include <stdio.h>
+
+#define NCHILD      128
+#define NORPHAN     16
+
+int
+main(void) {
+    int i, pid, code, pids[NCHILD], sum = 0;
+
+    // many children exiting at once are reaped one by one, each exactly once
+    for (i = 0; i < NCHILD; i ++) {
+        if ((pid = fork()) == 0) {
+            exit(i + 1);
+        }
+        assert(pid > 0);
+        pids[i] = pid;
+    }
+    for (i = 0; i < NCHILD / 2; i ++) {
+        assert(waitpid(0, &code) == 0 && code >= 1 && code <= NCHILD);
+        sum += code;
+    }
+    // a given one, when the others may be zombies too
+    for (i = NCHILD - 1; i >= 0; i --) {
+        if (waitpid(pids[i], &code) == 0) {
+            assert(code == i + 1);
+            sum += code;
+        }
+    }
+    assert(sum == NCHILD * (NCHILD + 1) / 2);
+    assert(wait() != 0);
+
+    // the children of an exited process go to init, which reaps them
+    if ((pid = fork()) == 0) {
+        for (i = 0; i < NORPHAN; i ++) {
+            if (fork() == 0) {
+                if (i % 2 == 0) {
+                    yield();
+                    yield();
+                }
+                exit(0);
+            }
+        }
+        exit(0);
+    }
+    assert(pid > 0 && waitpid(pid, &code) == 0 && code == 0);
+    assert(wait() != 0);
+
+    cprintf("reaptest pass.\n");
+    return 0;
+}
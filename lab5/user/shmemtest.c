@@ -0,0 +1,57 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define PAGES       16
+#define PGSIZE      4096
+#define LEN         (PAGES * PGSIZE)
+
+int
+main(void) {
+    int *shared = mmap(NULL, LEN, MMAP_WRITE | MMAP_SHARED);
+    int *private = mmap(NULL, LEN, MMAP_WRITE);
+    assert(shared != NULL && private != NULL && shared != private);
+
+    int i, pid, exit_code;
+    for (i = 0; i < PAGES; i ++) {
+        assert(shared[i * PGSIZE / sizeof(int)] == 0);
+        private[i * PGSIZE / sizeof(int)] = i;
+    }
+
+    // the child's writes to the shared region are seen by the parent,
+    // its writes to the private region are not
+    if ((pid = fork()) == 0) {
+        for (i = 0; i < PAGES; i ++) {
+            shared[i * PGSIZE / sizeof(int)] = i + 1;
+            private[i * PGSIZE / sizeof(int)] = -1;
+        }
+        exit(0);
+    }
+    assert(pid > 0 && waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    for (i = 0; i < PAGES; i ++) {
+        assert(shared[i * PGSIZE / sizeof(int)] == i + 1);
+        assert(private[i * PGSIZE / sizeof(int)] == i);
+    }
+
+    // and the other way round, also for a region the child unmaps itself
+    if ((pid = fork()) == 0) {
+        while (shared[0] != -1) {
+            yield();
+        }
+        for (i = 1; i < PAGES; i ++) {
+            assert(shared[i * PGSIZE / sizeof(int)] == -(i + 1));
+        }
+        assert(munmap(shared, LEN) == 0);
+        exit(0);
+    }
+    assert(pid > 0);
+    for (i = PAGES - 1; i >= 0; i --) {
+        shared[i * PGSIZE / sizeof(int)] = -(i + 1);
+    }
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    assert(shared[PGSIZE / sizeof(int)] == -2);
+
+    assert(munmap(shared, LEN) == 0 && munmap(private, LEN) == 0);
+    cprintf("shmemtest pass.\n");
+    return 0;
+}
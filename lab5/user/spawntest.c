@@ -0,0 +1,39 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <error.h>
+#include <string.h>
+#include <syscall.h>
+#include <unistd.h>
+
+int
+main(void) {
+    int pid, code;
+
+    // any program of the initrd can be started by path
+    assert((pid = spawn("/hello")) > 0);
+    assert(waitpid(pid, &code) == 0 && code == 0);
+    assert(spawn("nosuchprog") == -E_NOENT && spawn("") == -E_NOENT);
+
+    // a path outside the memory of the caller is refused, not read: kernel
+    // memory, no memory at all, and a page that was unmapped
+    const char *kernel = (const char *)0xFFFFFFFFC0200000;
+    assert(sys_spawn(kernel, 6) == -E_FAULT && sys_spawn(NULL, 6) == -E_FAULT);
+    char *buf = mmap(NULL, 4096, MMAP_WRITE);
+    assert(buf != NULL);
+    strcpy(buf, "/hello");
+    assert(munmap(buf, 4096) == 0);
+    assert(sys_spawn(buf, 6) == -E_FAULT);
+
+    // a failed exec returns, and the program keeps running
+    if ((pid = fork()) == 0) {
+        assert(exec("/no/such/prog") == -E_NOENT);
+        assert(sys_exec(kernel, 6) == -E_FAULT && sys_exec(buf, 6) == -E_FAULT);
+        exec("yield");
+        panic("exec yield failed.\n");
+    }
+    assert(pid > 0 && waitpid(pid, &code) == 0 && code == 0);
+
+    cprintf("spawntest pass.\n");
+    return 0;
+}
+
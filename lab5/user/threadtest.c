@@ -0,0 +1,76 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <thread.h>
+
+#define NTHREAD     8
+#define NROUND      100
+
+static volatile int counts[NTHREAD];
+static volatile int started;
+
+static int
+counter(void *arg) {
+    int id = (int)(long)arg, i;
+    started ++;
+    for (i = 0; i < NROUND; i ++) {
+        counts[id] ++;
+        if (i % 10 == 0) {
+            yield();
+        }
+    }
+    return id + 1;
+}
+
+static int
+spinner(void *arg) {
+    started ++;
+    while (1) {
+        yield();
+    }
+    return 0;
+}
+
+int
+main(void) {
+    thread_t tids[NTHREAD];
+    int i, code, pid;
+
+    // the threads see and change the same memory, and are joined one by one
+    for (i = 0; i < NTHREAD; i ++) {
+        assert(thread(counter, (void *)(long)i, &tids[i]) == 0);
+    }
+    for (i = NTHREAD - 1; i >= 0; i --) {
+        assert(thread_wait(&tids[i], &code) == 0 && code == i + 1);
+        assert(counts[i] == NROUND);
+    }
+    assert(started == NTHREAD && wait() != 0);
+    cprintf("threadtest: %d threads joined.\n", NTHREAD);
+
+    // exit takes the threads of the process down with it
+    if ((pid = fork()) == 0) {
+        started = 0;
+        for (i = 0; i < NTHREAD; i ++) {
+            assert(thread(spinner, NULL, &tids[i]) == 0);
+        }
+        while (started < NTHREAD) {
+            yield();
+        }
+        exit(0xbee);
+    }
+    assert(pid > 0 && waitpid(pid, &code) == 0 && code == 0xbee);
+    cprintf("threadtest: group exit.\n");
+
+    // and so does kill
+    if ((pid = fork()) == 0) {
+        assert(thread(spinner, NULL, &tids[0]) == 0);
+        while (1) {
+            yield();
+        }
+    }
+    yield();
+    yield();
+    assert(pid > 0 && kill(pid) == 0 && waitpid(pid, &code) == 0 && code != 0);
+    cprintf("threadtest pass.\n");
+    return 0;
+}
+
@@ -0,0 +1,7 @@
+#include <ulib.h>
+
+/* does nothing, successfully: the program execbench execs */
+int
+main(void) {
+    return 0;
+}
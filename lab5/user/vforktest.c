@@ -0,0 +1,30 @@
+#include <ulib.h>
+#include <stdio.h>
+
+volatile int shared_var = 1;
+
+int
+main(void) {
+    int pid, exit_code;
+
+    // the child borrows our memory, and we only run again once it is gone
+    if ((pid = vfork()) == 0) {
+        shared_var = getpid();
+        exit(7);
+    }
+    assert(pid > 0);
+    assert(shared_var == pid);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 7);
+
+    // fork still gives the child its own copy
+    if ((pid = fork()) == 0) {
+        shared_var = 0;
+        exit(0);
+    }
+    assert(pid > 0);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    assert(shared_var != 0);
+
+    cprintf("vforktest pass.\n");
+    return 0;
+}